@@ -27,14 +27,25 @@
 #include <bitcoin/server/interface/protocol.hpp>
 #include <bitcoin/server/interface/transaction_pool.hpp>
 #include <bitcoin/server/messages/message.hpp>
+#include <bitcoin/server/messages/message_queue.hpp>
 #include <bitcoin/server/messages/route.hpp>
+#include <bitcoin/server/messages/route_queues.hpp>
 #include <bitcoin/server/services/block_service.hpp>
 #include <bitcoin/server/services/heartbeat_service.hpp>
+#include <bitcoin/server/services/query_broker.hpp>
 #include <bitcoin/server/services/query_service.hpp>
 #include <bitcoin/server/services/transaction_service.hpp>
+#include <bitcoin/server/utility/address_index.hpp>
 #include <bitcoin/server/utility/address_key.hpp>
 #include <bitcoin/server/utility/authenticator.hpp>
+#include <bitcoin/server/utility/chain_tip.hpp>
 #include <bitcoin/server/utility/fetch_helpers.hpp>
+#include <bitcoin/server/utility/output_cache.hpp>
+#include <bitcoin/server/utility/parallel.hpp>
+#include <bitcoin/server/utility/query_task.hpp>
+#include <bitcoin/server/utility/request_coalescer.hpp>
+#include <bitcoin/server/utility/response_cache.hpp>
+#include <bitcoin/server/utility/transaction_fields.hpp>
 #include <bitcoin/server/workers/notification_worker.hpp>
 #include <bitcoin/server/workers/query_worker.hpp>
 
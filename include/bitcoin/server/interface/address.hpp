@@ -19,6 +19,8 @@
 #ifndef LIBBITCOIN_SERVER_ADDRESS_HPP
 #define LIBBITCOIN_SERVER_ADDRESS_HPP
 
+#include <cstdint>
+#include <bitcoin/bitcoin.hpp>
 #include <bitcoin/server/define.hpp>
 #include <bitcoin/server/messages/message.hpp>
 #include <bitcoin/server/server_node.hpp>
@@ -39,6 +41,11 @@ public:
     static void subscribe2(server_node& node, const message& request,
         send_handler handler);
 
+    /// Subscribe to address notifications with delivery options (batching,
+    /// compact payloads).
+    static void subscribe3(server_node& node, const message& request,
+        send_handler handler);
+
     /// Unsubscribe to payment and stealth address notifications by prefix.
     static void unsubscribe2(server_node& node, const message& request,
         send_handler handler);
@@ -46,6 +53,10 @@ public:
 private:
     static bool unwrap_subscribe2_args(binary& prefix_filter,
         const message& request);
+    static bool unwrap_subscribe3_args(binary& prefix_filter,
+        uint8_t& options, const message& request);
+    static bool unwrap_prefix(binary& prefix_filter,
+        data_chunk::const_iterator begin, data_chunk::const_iterator end);
 };
 
 } // namespace server
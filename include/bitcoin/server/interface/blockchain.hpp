@@ -20,6 +20,7 @@
 #define LIBBITCOIN_SERVER_BLOCKCHAIN_HPP
 
 #include <cstddef>
+#include <cstdint>
 #include <bitcoin/blockchain.hpp>
 #include <bitcoin/server/define.hpp>
 #include <bitcoin/server/messages/message.hpp>
@@ -38,6 +39,24 @@ public:
     static void fetch_history2(server_node& node,
         const message& request, send_handler handler);
 
+    /// Fetch the merged blockchain history of up to 1000 payment addresses,
+    /// failing if it exceeds 100000 rows.
+    static void fetch_history3(server_node& node,
+        const message& request, send_handler handler);
+
+    /// Fetch a page of the blockchain history of a payment address, within
+    /// its most recent 100000 rows.
+    static void fetch_history4(server_node& node,
+        const message& request, send_handler handler);
+
+    /// Fetch the confirmed balance of a payment address.
+    static void fetch_balance(server_node& node,
+        const message& request, send_handler handler);
+
+    /// Fetch the confirmed unspent outputs of a payment address.
+    static void fetch_unspent_outputs(server_node& node,
+        const message& request, send_handler handler);
+
     /// Fetch a transaction from the blockchain by its hash.
     static void fetch_transaction(server_node& node,
         const message& request, send_handler handler);
@@ -46,10 +65,19 @@ public:
     static void fetch_last_height(server_node& node,
         const message& request, send_handler handler);
 
+    /// Fetch the height, hash and header of the top block of the chain.
+    static void fetch_tip(server_node& node,
+        const message& request, send_handler handler);
+
     /// Fetch a block header by hash or height (conditional serialization).
     static void fetch_block_header(server_node& node,
         const message& request, send_handler handler);
 
+    /// Fetch a range of block headers by height or block locator (of up to
+    /// 500 hashes).
+    static void fetch_block_headers(server_node& node,
+        const message& request, send_handler handler);
+
     /// Fetch tx hashes of block by hash or height (conditional serialization).
     static void fetch_block_transaction_hashes(server_node& node,
         const message& request, send_handler handler);
@@ -83,28 +111,23 @@ public:
         send_handler handler);
 
 private:
-    static void last_height_fetched(const code& ec, size_t last_height,
-        const message& request, send_handler handler);
-
-    static void fetch_block_header_by_hash(server_node& node,
-        const message& request, send_handler handler);
+    static bool unwrap_fetch_history3_args(
+        wallet::payment_address::list& addresses, size_t& from_height,
+        const message& request);
 
-    static void fetch_block_header_by_height(server_node& node,
-        const message& request, send_handler handler);
+    static bool unwrap_fetch_history4_args(
+        wallet::payment_address& address, size_t& from_height,
+        uint32_t& offset, uint32_t& rows, const message& request);
 
-    static void block_header_fetched(const code& ec,
-        header_const_ptr header, const message& request,
-        send_handler handler);
+    static bool unwrap_fetch_outputs_args(wallet::payment_address& address,
+        uint32_t& min_confirmations, const message& request);
 
-    static void fetch_block_transaction_hashes_by_hash(server_node& node,
-        const message& request, send_handler handler);
+    static bool unwrap_fetch_block_headers_args(uint32_t& from_height,
+        uint32_t& count, hash_list& locator, const message& request);
 
-    static void fetch_block_transaction_hashes_by_height(server_node& node,
+    static void last_height_fetched(const code& ec, size_t last_height,
         const message& request, send_handler handler);
 
-    static void merkle_block_fetched(const code& ec, merkle_block_ptr block,
-        size_t height, const message& request, send_handler handler);
-
     static void transaction_index_fetched(const code& ec,
         size_t tx_position, size_t block_height, const message& request,
         send_handler handler);
@@ -20,6 +20,7 @@
 #define LIBBITCOIN_SERVER_MESSAGE
 
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <bitcoin/protocol.hpp>
 #include <bitcoin/server/define.hpp>
@@ -28,9 +29,15 @@
 namespace libbitcoin {
 namespace server {
 
+/// The payload is moved through receive, construction and send, so the
+/// server does not copy it. A payload delivered to many requests (coalesced
+/// or cached) is shared by reference count, and is copied only into the
+/// outgoing frame.
 class BCS_API message
 {
 public:
+    typedef std::shared_ptr<const data_chunk> chunk_ptr;
+
     static data_chunk to_bytes(const code& ec);
 
     //// Construct an empty message with security routing context.
@@ -42,6 +49,12 @@ public:
     //// Construct a response for the request (data with code).
     message(const message& request, const data_chunk& data);
 
+    //// Construct a response for the request (moved data with code).
+    message(const message& request, data_chunk&& data);
+
+    //// Construct a response for the request (shared data with code).
+    message(const message& request, chunk_ptr data);
+
     //// Construct a response for the route (subscription code only).
     message(const server::route& route, const std::string& command,
         uint32_t id, const code& ec);
@@ -50,12 +63,23 @@ public:
     message(const server::route& route, const std::string& command,
         uint32_t id, const data_chunk& data);
 
+    //// Construct a response for the route (moved data with code).
+    message(const server::route& route, const std::string& command,
+        uint32_t id, data_chunk&& data);
+
+    //// Construct a response for the route (shared data with code).
+    message(const server::route& route, const std::string& command,
+        uint32_t id, chunk_ptr data);
+
     /// Arbitrary caller data (returned to caller for correlation).
     uint32_t id() const;
 
     /// Serialized query or response (defined in relation to command).
     const data_chunk& data() const;
 
+    /// Move the payload to a shared buffer (if not shared) and return it.
+    chunk_ptr share();
+
     /// Query command (used for subscription, always returned to caller).
     const std::string& command() const;
 
@@ -65,12 +89,13 @@ public:
     /// Receive a message via the socket.
     code receive(bc::protocol::zmq::socket& socket);
 
-    /// Send the message via the socket.
+    /// Send the message via the socket, an unshared payload is moved out.
     code send(bc::protocol::zmq::socket& socket);
 
 private:
     uint32_t id_;
     data_chunk data_;
+    chunk_ptr shared_;
     server::route route_;
     std::string command_;
 };
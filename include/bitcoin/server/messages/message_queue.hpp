@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_SERVER_MESSAGE_QUEUE
+#define LIBBITCOIN_SERVER_MESSAGE_QUEUE
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <bitcoin/protocol.hpp>
+#include <bitcoin/server/define.hpp>
+#include <bitcoin/server/messages/message.hpp>
+#include <boost/lockfree/queue.hpp>
+
+namespace libbitcoin {
+namespace server {
+
+/// This class is thread safe for any number of producers and one consumer.
+/// A lock-free handoff of messages to the thread that owns the sending
+/// socket, since zeromq sockets may not be shared between threads.
+/// A push that the lock-free queue cannot accept spills to a bounded list,
+/// and the consumer is woken by an inproc signal rather than by polling.
+class BCS_API message_queue
+{
+public:
+    /// Handoff counters, accumulated since the previous report.
+    struct statistics
+    {
+        size_t spilled;
+        size_t dropped;
+    };
+
+    /// Construct an empty queue.
+    message_queue();
+
+    /// Free any messages that were not dequeued.
+    ~message_queue();
+
+    /// This class is not copyable.
+    message_queue(const message_queue&) = delete;
+    void operator=(const message_queue&) = delete;
+
+    /// Bind and connect the wakeup signal pair (consumer thread only).
+    bool open(bc::protocol::zmq::authenticator& authenticator);
+
+    /// Close the wakeup signal pair (consumer thread only).
+    void close();
+
+    /// The socket to poll, readable after a push (consumer thread only).
+    bc::protocol::zmq::socket& signal();
+
+    /// Consume a readable signal before dequeuing (consumer thread only).
+    void acknowledge();
+
+    /// Enqueue a message and signal the consumer, callable from any thread.
+    void push(message&& item);
+
+    /// Dequeue the oldest message, false if empty (consumer thread only).
+    bool pop(message& out);
+
+    /// The counters since the previous report, which are then reset.
+    statistics report();
+
+private:
+    typedef std::unique_ptr<bc::protocol::zmq::socket> socket_ptr;
+
+    void spill(std::unique_ptr<message> item);
+    void wake();
+
+    boost::lockfree::queue<message*> queue_;
+
+    // These are thread safe.
+    std::atomic<bool> signaled_;
+    std::atomic<bool> spilling_;
+    std::atomic<size_t> spilled_;
+    std::atomic<size_t> dropped_;
+
+    // This is used only on the consumer thread.
+    socket_ptr receiver_;
+
+    // This is protected by mutex.
+    socket_ptr sender_;
+    mutable std::mutex sender_mutex_;
+
+    // This is protected by mutex.
+    std::deque<message> spill_;
+    mutable std::mutex spill_mutex_;
+};
+
+} // namespace server
+} // namespace libbitcoin
+
+#endif
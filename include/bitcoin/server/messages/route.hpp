@@ -48,10 +48,10 @@ public:
     /// The message route is delimited using an empty frame.
     bool delimited;
 
-    /// The first address.
+    /// The first address (the query service shard of the client).
     data_chunk address1;
 
-    /// The second address.
+    /// The second address (the client, within the query service shard).
     data_chunk address2;
 };
 
@@ -69,7 +69,7 @@ namespace std
             boost::hash_combine(seed, value.secure);
             ////boost::hash_combine(seed, value.delimited);
             boost::hash_combine(seed, value.address1);
-            ////boost::hash_combine(seed, value.address2);
+            boost::hash_combine(seed, value.address2);
             return seed;
         }
     };
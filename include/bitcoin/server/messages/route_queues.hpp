@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_SERVER_ROUTE_QUEUES
+#define LIBBITCOIN_SERVER_ROUTE_QUEUES
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <bitcoin/protocol.hpp>
+#include <bitcoin/server/define.hpp>
+#include <bitcoin/server/messages/message.hpp>
+#include <bitcoin/server/messages/route.hpp>
+#include <bitcoin/server/settings.hpp>
+
+namespace libbitcoin {
+namespace server {
+
+/// This class is not thread safe, it is owned by the sending thread.
+/// Bounded notification queues per client route, sent round robin with a
+/// limit per client per send, so that one lagging client sheds its own
+/// notifications (according to policy) rather than those of other clients.
+/// A client that the query service reports at high water is not sent to for
+/// a time, so its queue fills and sheds instead of the client socket.
+class BCS_API route_queues
+{
+public:
+    /// Client counters, accumulated since the previous report.
+    struct statistics
+    {
+        size_t queued;
+        size_t peak;
+        uint64_t sent;
+        uint64_t dropped;
+        uint64_t disconnects;
+        uint64_t blocked;
+    };
+
+    typedef std::function<void(const route&, const statistics&)>
+        report_handler;
+
+    /// Construct queues of the given depth (zero is unbounded).
+    route_queues(size_t depth, queue_policy policy);
+
+    /// This class is not copyable.
+    route_queues(const route_queues&) = delete;
+    void operator=(const route_queues&) = delete;
+
+    /// Enqueue the message on its route's queue, applying the policy if full.
+    /// Returns false if the client was disconnected by policy, in which case
+    /// its queue is cleared and the message is discarded.
+    bool push(message&& item);
+
+    /// Hold the client's queue until the given time, as its last message was
+    /// rejected by the query service (which counts as dropped).
+    void block(const route& client, const asio::time_point& until);
+
+    /// The earliest time at which a client queue may send, or max if none.
+    asio::time_point next() const;
+
+    /// Send up to burst messages from each client queue that is not held,
+    /// returns the count.
+    size_t send(bc::protocol::zmq::socket& router, size_t burst,
+        const asio::time_point& now);
+
+    /// Invoke the handler for each client with activity since the previous
+    /// report, then reset counters and release idle clients.
+    void report(report_handler handler);
+
+private:
+    struct client
+    {
+        client();
+
+        std::deque<message> pending;
+        statistics counters;
+        asio::time_point resume;
+        bool scheduled;
+    };
+
+    typedef std::unordered_map<route, client> clients;
+
+    bool shed(client& target, const message& item);
+
+    const size_t depth_;
+    const queue_policy policy_;
+    clients clients_;
+    std::vector<client*> ready_;
+};
+
+} // namespace server
+} // namespace libbitcoin
+
+#endif
@@ -19,6 +19,7 @@
 #ifndef LIBBITCOIN_SERVER_SERVER_NODE_HPP
 #define LIBBITCOIN_SERVER_SERVER_NODE_HPP
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <bitcoin/node.hpp>
@@ -32,6 +33,12 @@
 #include <bitcoin/server/services/query_service.hpp>
 #include <bitcoin/server/services/transaction_service.hpp>
 #include <bitcoin/server/utility/authenticator.hpp>
+#include <bitcoin/server/utility/chain_tip.hpp>
+#include <bitcoin/server/utility/output_cache.hpp>
+#include <bitcoin/server/utility/parallel.hpp>
+#include <bitcoin/server/utility/request_coalescer.hpp>
+#include <bitcoin/server/utility/response_cache.hpp>
+#include <bitcoin/server/utility/transaction_fields.hpp>
 #include <bitcoin/server/workers/notification_worker.hpp>
 
 #ifdef WITH_LOCAL_MINING
@@ -63,6 +70,22 @@ public:
     /// Server configuration settings.
     virtual const settings& server_settings() const;
 
+    /// The top block of the chain, maintained from reorganizations.
+    virtual chain_tip& tip();
+
+    /// Cache of immutable query responses, shared by all query workers.
+    virtual response_cache& responses();
+
+    /// Read-only queries in flight, shared by all query workers.
+    virtual request_coalescer& pending_requests();
+
+    /// Address outputs for balance queries, shared by all query workers.
+    virtual output_cache& outputs();
+
+    /// Batched history reads posted to the threadpool, shared by all query
+    /// workers.
+    virtual concurrency_limit& history_batches();
+
     // Run sequence.
     // ------------------------------------------------------------------------
 
@@ -88,7 +111,7 @@ public:
     /// Subscribe to address (including stealth) prefix notifications.
     /// Stealth prefix is limited to 32 bits, address prefix to 256 bits.
     virtual void subscribe_address(const route& reply_to, uint32_t id,
-        const binary& prefix_filter, bool unsubscribe);
+        const binary& prefix_filter, uint8_t options, bool unsubscribe);
 
     /////// Subscribe to transaction penetration notifications.
     ////virtual void subscribe_penetration(const route& reply_to, uint32_t id,
@@ -97,20 +120,37 @@ public:
 private:
     void handle_running(const code& ec, result_handler handler);
 
+    // Invalidate caches and extract notification fields once for all
+    // notification workers.
+    bool handle_reorganization(const code& ec, size_t fork_height,
+        block_const_ptr_list_const_ptr new_blocks,
+        block_const_ptr_list_const_ptr old_blocks);
+    bool handle_transaction_pool(const code& ec, transaction_const_ptr tx);
+    transaction_fields::list extract(block_const_ptr block);
+
+    bool check_endpoints() const;
     bool start_services();
     bool start_authenticator();
+    bool start_chain_tracking();
     bool start_query_services();
     bool start_heartbeat_services();
     bool start_block_services();
     bool start_transaction_services();
-    bool start_query_workers(bool secure);
+    bool start_query_shards(bool secure);
+    bool start_query_workers(bool secure, uint16_t shard);
+    bool start_query_workers(bool secure, uint16_t shard,
+        query_service::lane lane, uint16_t count);
+    void start_notification_relay();
 
     const configuration& configuration_;
 
     // These are thread safe.
     authenticator authenticator_;
-    query_service secure_query_service_;
-    query_service public_query_service_;
+    chain_tip tip_;
+    response_cache responses_;
+    request_coalescer pending_requests_;
+    output_cache outputs_;
+    concurrency_limit history_batches_;
     heartbeat_service secure_heartbeat_service_;
     heartbeat_service public_heartbeat_service_;
     block_service secure_block_service_;
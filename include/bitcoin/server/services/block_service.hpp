@@ -67,7 +67,10 @@ private:
         block_const_ptr_list_const_ptr old_blocks);
 
     void publish_blocks(uint32_t fork_height,
-        block_const_ptr_list_const_ptr blocks);
+        block_const_ptr_list_const_ptr new_blocks,
+        block_const_ptr_list_const_ptr old_blocks);
+    void publish_reorganization(socket& publisher, uint32_t fork_height,
+        const block_const_ptr_list& old_blocks);
     void publish_block(socket& publisher, uint32_t height,
         block_const_ptr block);
 
@@ -0,0 +1,81 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_SERVER_QUERY_BROKER_HPP
+#define LIBBITCOIN_SERVER_QUERY_BROKER_HPP
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <bitcoin/protocol.hpp>
+#include <bitcoin/server/define.hpp>
+#include <bitcoin/server/services/query_service.hpp>
+
+namespace libbitcoin {
+namespace server {
+
+// This class is not thread safe, it is used on the thread of its service.
+// The broker loop of a query service shard, over sockets bound by the
+// service. Queries from the client router are dispatched to the dealer of
+// their lane, and responses and notifications from the dealers are forwarded
+// to the client router.
+class BCS_API query_broker
+{
+public:
+    typedef bc::protocol::zmq::socket socket;
+    typedef std::function<bool()> stopped_handler;
+
+    /// Construct a broker, a lane without workers is dispatched as cheap.
+    query_broker(socket& router, socket& query_dealer, socket& heavy_dealer,
+        socket& broadcast_dealer, socket& notify_dealer, bool heavy,
+        bool broadcast);
+
+    /// Relay until the context is terminated or the handler returns true.
+    void run(stopped_handler stopped);
+
+    /// Forward a query from the router to the dealer of its lane.
+    bool dispatch();
+
+    /// Forward a response to the router, dropping it if the client is lost
+    /// or at high water.
+    bool respond(socket& dealer);
+
+    /// Forward a notification to the router, returning it if at high water.
+    bool notify();
+
+    /// The number of messages dropped for lost or blocked clients.
+    size_t dropped() const;
+
+private:
+    // The lane of the command, cheap if the lane has no workers.
+    query_service::lane to_lane(const std::string& command) const;
+
+    socket& router_;
+    socket& query_dealer_;
+    socket& heavy_dealer_;
+    socket& broadcast_dealer_;
+    socket& notify_dealer_;
+    const bool heavy_;
+    const bool broadcast_;
+    size_t dropped_;
+};
+
+} // namespace server
+} // namespace libbitcoin
+
+#endif
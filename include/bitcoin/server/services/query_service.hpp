@@ -19,7 +19,9 @@
 #ifndef LIBBITCOIN_SERVER_QUERY_SERVICE_HPP
 #define LIBBITCOIN_SERVER_QUERY_SERVICE_HPP
 
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <bitcoin/protocol.hpp>
 #include <bitcoin/server/define.hpp>
 #include <bitcoin/server/settings.hpp>
@@ -31,28 +33,60 @@ class server_node;
 
 // This class is thread safe.
 // Submit queries and address subscriptions and receive address notifications.
+// Queries are dispatched to the workers of their cost class (lane), so that
+// cheap queries do not wait behind history scans or transaction validation.
+// Each shard of the service is a broker with its own client endpoint and
+// workers, so that brokering scales across cores.
 class BCS_API query_service
   : public bc::protocol::zmq::worker
 {
 public:
     typedef std::shared_ptr<query_service> ptr;
 
-    /// The fixed inprocess query and notify worker endpoints.
+    /// The query worker pools, by cost of query.
+    enum class lane
+    {
+        cheap,
+        heavy,
+        broadcast
+    };
+
+    /// The fixed inprocess query and notify worker endpoints (of shard zero).
     static const config::endpoint public_query;
     static const config::endpoint secure_query;
+    static const config::endpoint public_heavy_query;
+    static const config::endpoint secure_heavy_query;
+    static const config::endpoint public_broadcast_query;
+    static const config::endpoint secure_broadcast_query;
     static const config::endpoint public_notify;
     static const config::endpoint secure_notify;
 
-    /// Construct a query service.
+    /// The lane of the command, cheap if not classified.
+    static lane classify(const std::string& command);
+
+    /// The query worker endpoint of the lane of the shard.
+    static config::endpoint worker_endpoint(lane lane, bool secure,
+        uint16_t shard);
+
+    /// The notification worker endpoint of the shard.
+    static config::endpoint notify_endpoint(bool secure, uint16_t shard);
+
+    /// The configured client endpoint of the shard, false if there is none.
+    static bool client_endpoint(config::endpoint& out,
+        const settings& settings, bool secure, uint16_t shard);
+
+    /// Construct a query service shard.
     query_service(bc::protocol::zmq::authenticator& authenticator,
-        server_node& node, bool secure);
+        server_node& node, bool secure, uint16_t shard);
 
 protected:
     typedef bc::protocol::zmq::socket socket;
 
     virtual bool bind(socket& router, socket& query_dealer,
+        socket& heavy_dealer, socket& broadcast_dealer,
         socket& notify_dealer);
     virtual bool unbind(socket& router, socket& query_dealer,
+        socket& heavy_dealer, socket& broadcast_dealer,
         socket& notify_dealer);
 
     // Implement the service.
@@ -60,6 +94,7 @@ protected:
 
 private:
     const bool secure_;
+    const uint16_t shard_;
     const server::settings& settings_;
 
     // This is thread safe.
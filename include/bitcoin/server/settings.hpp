@@ -20,6 +20,7 @@
 #define LIBBITCOIN_SERVER_SETTINGS_HPP
 
 #include <cstdint>
+#include <iostream>
 #include <string>
 #include <vector>
 #include <boost/filesystem.hpp>
@@ -30,6 +31,23 @@
 namespace libbitcoin {
 namespace server {
 
+/// The treatment of a notification to a client whose queue is full.
+enum class queue_policy
+{
+    /// Discard the client's oldest queued notification.
+    drop_oldest,
+
+    /// Discard all queued notifications and subscriptions of the client.
+    disconnect,
+
+    /// Discard the oldest queued notification of the same subscription.
+    coalesce
+};
+
+BCS_API std::istream& operator>>(std::istream& input, queue_policy& argument);
+BCS_API std::ostream& operator<<(std::ostream& output,
+    const queue_policy& argument);
+
 /// Common database configuration settings, properties not thread safe.
 class BCS_API settings
 {
@@ -40,19 +58,31 @@ public:
     /// Properties.
     bool secure_only;
 
+    uint16_t query_shards;
     uint16_t query_workers;
+    uint16_t heavy_query_workers;
+    uint16_t broadcast_query_workers;
+    uint32_t response_cache_size;
+    uint16_t query_parallelism;
     uint32_t subscription_limit;
     uint32_t subscription_expiration_minutes;
+    uint16_t notification_parallelism;
+    uint32_t notification_queue_depth;
+    queue_policy notification_queue_policy;
+    boost::filesystem::path subscription_snapshot_directory;
     uint32_t heartbeat_interval_seconds;
     bool block_service_enabled;
+    bool block_reorganizations_enabled;
     bool transaction_service_enabled;
 
     config::endpoint public_query_endpoint;
+    config::endpoint::list public_query_shard_endpoints;
     config::endpoint public_heartbeat_endpoint;
     config::endpoint public_block_endpoint;
     config::endpoint public_transaction_endpoint;
 
     config::endpoint secure_query_endpoint;
+    config::endpoint::list secure_query_shard_endpoints;
     config::endpoint secure_heartbeat_endpoint;
     config::endpoint secure_block_endpoint;
     config::endpoint secure_transaction_endpoint;
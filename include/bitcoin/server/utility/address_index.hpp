@@ -0,0 +1,214 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_SERVER_ADDRESS_INDEX_HPP
+#define LIBBITCOIN_SERVER_ADDRESS_INDEX_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <bitcoin/bitcoin.hpp>
+#include <bitcoin/server/define.hpp>
+#include <bitcoin/server/messages/route.hpp>
+
+namespace libbitcoin {
+namespace server {
+
+/// This class is thread safe.
+/// A path-compressed binary trie of address subscriptions keyed by prefix.
+/// Matching a payment address hash or stealth prefix visits only the nodes
+/// along the path of the field, so the cost of a relay is proportional to the
+/// field length and the number of matching subscriptions, not to the number
+/// of subscriptions. Expiration deadlines are held in a hierarchical timer
+/// wheel, so a purge visits only the subscriptions scheduled in the elapsed
+/// ticks, and a deadline beyond the horizon is moved once per revolution.
+class BCS_API address_index
+{
+public:
+    typedef std::shared_ptr<address_index> ptr;
+
+    /// A single subscription, shared between the index and its notifier.
+    struct subscription
+    {
+        typedef std::shared_ptr<subscription> ptr;
+        typedef std::vector<ptr> list;
+
+        /// Delivery options, requested by address.subscribe3.
+        enum option : uint8_t
+        {
+            none = 0,
+
+            /// Deliver all matches of a block (or pool interval) together.
+            batch = 1,
+
+            /// Deliver transaction hashes and matching positions only.
+            compact = 2
+        };
+
+        subscription(const route& reply_to, uint32_t id,
+            const binary& prefix_filter, uint8_t options,
+            const asio::time_point& expires);
+
+        /// The subscriber's route and correlation identifier.
+        const route reply_to;
+        const uint32_t id;
+
+        /// The subscribed prefix, the key within the index.
+        const binary prefix_filter;
+
+        /// The delivery options, fixed by the initial subscription.
+        const uint8_t options;
+
+        /// The sequence enables the client to detect dropped messages.
+        std::atomic<uint8_t> sequence;
+
+        /// The subscription expires at this time unless renewed.
+        asio::time_point expires;
+
+        /// False if restored and not since renewed, the route may be stale.
+        bool confirmed;
+
+        /// Record a pool transaction delivered to a compact subscriber.
+        /// The most recent are retained, so confirmation may be abbreviated.
+        void remember(const hash_digest& tx_hash);
+
+        /// Remove the pool transaction, true if it was delivered.
+        bool forget(const hash_digest& tx_hash);
+
+    private:
+        // These are protected by mutex.
+        std::deque<hash_digest> delivered_order_;
+        std::unordered_set<hash_digest> delivered_;
+        mutable std::mutex mutex_;
+    };
+
+    /// Construct an index limited to the specified number of subscriptions.
+    /// The horizon is the longest expected subscription duration, which sets
+    /// the expiration resolution (longer durations are held by revolution).
+    address_index(size_t limit, const asio::duration& horizon);
+
+    /// This class is not copyable.
+    address_index(const address_index&) = delete;
+    void operator=(const address_index&) = delete;
+
+    /// The number of subscriptions in the index.
+    size_t size() const;
+
+    /// The expiration resolution, the useful interval between purges.
+    asio::duration resolution() const;
+
+    /// Add the subscription, or renew it if the route/prefix already exists.
+    /// Returns false if the index is stopped or the limit has been reached.
+    bool subscribe(const route& reply_to, uint32_t id,
+        const binary& prefix_filter, const asio::duration& duration,
+        uint8_t options=subscription::none);
+
+    /// Remove the subscription, returns nullptr if not found.
+    subscription::ptr unsubscribe(const route& reply_to,
+        const binary& prefix_filter);
+
+    /// Remove all subscriptions of the route, appending each to out.
+    /// This visits every node, so is intended for infrequent use.
+    void unsubscribe(const route& reply_to, subscription::list& out);
+
+    /// Append each confirmed subscription with a prefix of the field to out.
+    void match(subscription::list& out, const binary& field) const;
+
+    /// Remove expired subscriptions, appending each to out.
+    /// Renewed and unsubscribed entries are rescheduled or dropped lazily as
+    /// their wheel slot is reached, so renewal and removal are constant time.
+    void purge(subscription::list& out);
+
+    /// Remove subscriptions expired at the given time, appending each to out.
+    /// The time must not precede that of a previous purge.
+    void purge(subscription::list& out, const asio::time_point& now);
+
+    /// Remove all subscriptions, appending each to out, and reject new ones.
+    void stop(subscription::list& out);
+
+    /// Restore subscriptions written by to_data, returns false if invalid.
+    /// A route address over 255 bytes or a prefix over the bits of an
+    /// address hash is invalid, and ends the restore.
+    /// Subscriptions that expired in the interim or exceed the limit are
+    /// skipped, and existing subscriptions are not replaced. A restored
+    /// subscription is unconfirmed (not matched) until renewed, and expires
+    /// if not renewed within the expiration.
+    bool from_data(reader& source, const asio::duration& expiration);
+
+    /// Write all subscriptions with their sequence and remaining duration.
+    void to_data(writer& sink) const;
+
+private:
+    typedef std::unordered_map<route, subscription::ptr> subscriptions;
+    typedef std::vector<subscription::list> wheel;
+
+    // Each node holds the full prefix of its position in the trie.
+    struct node
+    {
+        typedef std::unique_ptr<node> ptr;
+
+        node(const binary& prefix);
+
+        const binary prefix;
+        subscriptions entries;
+        ptr children[2];
+    };
+
+    static node* find(node& parent, const binary& prefix_filter);
+    static void insert(node& parent, subscription::ptr entry);
+    static subscription::ptr erase(node& parent, const route& reply_to,
+        const binary& prefix_filter);
+    static void collect(node& parent, subscription::list& out);
+    static void enumerate(const node& parent, subscription::list& out);
+    static void collect(node& parent, const route& reply_to,
+        subscription::list& out);
+    static void compact(node::ptr& slot);
+
+    // Timer wheel operations (must be called under lock).
+    uint64_t tick(const asio::time_point& time) const;
+    void schedule(subscription::ptr entry);
+    void cascade(uint64_t first, uint64_t last);
+    void expire(subscription::list& slot, const asio::time_point& now,
+        subscription::list& out);
+    bool indexed(const subscription& entry);
+
+    // These are thread safe.
+    const size_t limit_;
+    const asio::duration resolution_;
+    const asio::time_point origin_;
+    std::atomic<size_t> size_;
+
+    // These are protected by mutex.
+    bool stopped_;
+    node root_;
+    wheel inner_;
+    wheel outer_;
+    uint64_t cursor_;
+    mutable shared_mutex mutex_;
+};
+
+} // namespace server
+} // namespace libbitcoin
+
+#endif
@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_SERVER_CHAIN_TIP_HPP
+#define LIBBITCOIN_SERVER_CHAIN_TIP_HPP
+
+#include <cstddef>
+#include <memory>
+#include <bitcoin/bitcoin.hpp>
+#include <bitcoin/server/define.hpp>
+
+namespace libbitcoin {
+namespace server {
+
+/// This class is thread safe.
+/// The top block of the chain, read once at startup (or by the first tip
+/// query if that read fails) and then replaced from the reorganization
+/// subscription, so that tip queries are served from memory. Readers share
+/// an immutable snapshot.
+class BCS_API chain_tip
+{
+public:
+    struct snapshot
+    {
+        size_t height;
+        hash_digest hash;
+        chain::header header;
+    };
+
+    typedef std::shared_ptr<const snapshot> ptr;
+
+    /// Construct an unset tip.
+    chain_tip();
+
+    /// This class is not copyable.
+    chain_tip(const chain_tip&) = delete;
+    void operator=(const chain_tip&) = delete;
+
+    /// The current tip, or nullptr if not yet set.
+    ptr get() const;
+
+    /// Set the tip if it has not been set by a reorganization.
+    void initialize(size_t height, const chain::header& header);
+
+    /// Replace the tip.
+    void set(size_t height, const chain::header& header);
+
+private:
+    // This is protected by mutex.
+    ptr tip_;
+    mutable shared_mutex mutex_;
+};
+
+} // namespace server
+} // namespace libbitcoin
+
+#endif
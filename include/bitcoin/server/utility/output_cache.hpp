@@ -0,0 +1,106 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_SERVER_OUTPUT_CACHE_HPP
+#define LIBBITCOIN_SERVER_OUTPUT_CACHE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <bitcoin/bitcoin.hpp>
+#include <bitcoin/server/define.hpp>
+
+namespace libbitcoin {
+namespace server {
+
+/// This class is thread safe.
+/// A row-bounded LRU cache of the outputs of address histories, each marked
+/// with the height of its spend if spent, from which balance and unspent
+/// output queries are computed at any confirmation depth.
+/// Outputs are independent of the chain top, so a new block discards only
+/// the addresses that it pays or spends, and a reorganization discards all.
+class BCS_API output_cache
+{
+public:
+    struct output
+    {
+        chain::output_point point;
+        size_t height;
+        uint64_t value;
+        bool spent;
+        size_t spent_height;
+    };
+
+    typedef std::vector<output> list;
+    typedef std::shared_ptr<const list> list_ptr;
+
+    /// The outputs of the history, spends are matched by point checksum.
+    static list_ptr to_outputs(const chain::history_compact::list& history);
+
+    /// Construct an empty cache.
+    output_cache();
+
+    /// This class is not copyable.
+    output_cache(const output_cache&) = delete;
+    void operator=(const output_cache&) = delete;
+
+    /// The invalidation epoch, capture before the history that is stored.
+    size_t epoch() const;
+
+    /// The outputs of the address, or nullptr if not cached.
+    list_ptr find(const short_hash& address_hash);
+
+    /// Store the outputs of the address, unless invalidated since epoch.
+    void store(const short_hash& address_hash, list_ptr outputs,
+        size_t epoch);
+
+    /// Discard the addresses paid or spent by the block.
+    void invalidate(const chain::block& block);
+
+    /// Discard all addresses.
+    void clear();
+
+private:
+    struct entry
+    {
+        short_hash address_hash;
+        list_ptr outputs;
+    };
+
+    typedef std::list<entry> entry_list;
+
+    void erase(const short_hash& address_hash);
+    void evict();
+
+    // These are protected by mutex.
+    entry_list entries_;
+    std::unordered_map<short_hash, entry_list::iterator> addresses_;
+    size_t rows_;
+    std::atomic<size_t> epoch_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace server
+} // namespace libbitcoin
+
+#endif
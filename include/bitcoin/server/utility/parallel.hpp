@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_SERVER_PARALLEL_HPP
+#define LIBBITCOIN_SERVER_PARALLEL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <bitcoin/bitcoin.hpp>
+#include <bitcoin/server/define.hpp>
+
+namespace libbitcoin {
+namespace server {
+
+/// Invoked with the half-open range [first, last) of a partition.
+typedef std::function<void(size_t first, size_t last)> range_handler;
+
+/// Partition [0, count) into at most parallelism contiguous ranges and invoke
+/// the handler for each, returning once all have completed. The calling
+/// thread works alongside the pool, so completion does not depend on pool
+/// availability (the caller may itself be a pool thread). Small counts and
+/// a parallelism of zero or one run entirely on the calling thread.
+BCS_API void parallel_for(threadpool& pool, size_t count, size_t parallelism,
+    range_handler handler);
+
+/// Partition [0, count) into at most parallelism contiguous ranges, of no
+/// minimum size, and post the handler for each to the pool, returning
+/// immediately. The handler must signal its own completion (e.g. the last
+/// range to complete sends a response). A parallelism of zero is one range.
+BCS_API void parallel_post(threadpool& pool, size_t count, size_t parallelism,
+    range_handler handler);
+
+/// This class is thread safe.
+/// Bounds the number of concurrent uses of a resource, such as the threads
+/// of a pool, without blocking. A caller denied a use does the work itself.
+class BCS_API concurrency_limit
+{
+public:
+    concurrency_limit(size_t limit);
+
+    /// Claim a use, false if the limit is reached.
+    bool try_acquire();
+
+    /// Release a claimed use.
+    void release();
+
+private:
+    const size_t limit_;
+    std::atomic<size_t> count_;
+};
+
+} // namespace server
+} // namespace libbitcoin
+
+#endif
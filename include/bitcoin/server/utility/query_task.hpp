@@ -0,0 +1,117 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_SERVER_QUERY_TASK_HPP
+#define LIBBITCOIN_SERVER_QUERY_TASK_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <boost/asio/coroutine.hpp>
+#include <bitcoin/server/define.hpp>
+
+namespace libbitcoin {
+namespace server {
+
+/// This class is thread safe.
+/// A stackless coroutine for a query of one or more sequential chain calls.
+///
+/// The Task implements resume() as a boost::asio reenter block that yields on
+/// each call with next() as its handler, and receive() overloads that accept
+/// the results of each call. The handler holds only the task pointer, so
+/// std::function stores it without allocation. The task is the only
+/// allocation of the query and is freed when the coroutine completes.
+///
+/// Results may arrive on any thread, or within the call itself (as most
+/// chain fetches complete synchronously). A result that arrives within the
+/// call is resumed by the loop of the caller, so the stack does not grow.
+template <typename Task>
+class query_task
+  : public boost::asio::coroutine
+{
+public:
+    /// Allocate and run the task until its first asynchronous call.
+    template <typename... Args>
+    static void start(Args&&... args)
+    {
+        drive(new Task(std::forward<Args>(args)...));
+    }
+
+protected:
+    /// The handler of a yielded call, resumes the task with its results.
+    class continuation
+    {
+    public:
+        continuation(Task* task)
+          : task_(task)
+        {
+        }
+
+        template <typename... Results>
+        void operator()(Results&&... results) const
+        {
+            task_->receive(std::forward<Results>(results)...);
+            signal(task_);
+        }
+
+    private:
+        Task* task_;
+    };
+
+    query_task()
+      : signals_(1)
+    {
+    }
+
+    /// The handler for the call of the current step.
+    continuation next()
+    {
+        return continuation(static_cast<Task*>(this));
+    }
+
+private:
+    // A zero count means the task is suspended awaiting a result.
+    static void signal(Task* task)
+    {
+        if (task->signals_.fetch_add(1) == 0)
+            drive(task);
+    }
+
+    // Completion is tested before release, as a released task may be
+    // resumed (and freed) on another thread.
+    static void drive(Task* task)
+    {
+        do
+        {
+            task->resume();
+
+            if (task->is_complete())
+            {
+                delete task;
+                return;
+            }
+        } while (--task->signals_ != 0);
+    }
+
+    std::atomic<size_t> signals_;
+};
+
+} // namespace server
+} // namespace libbitcoin
+
+#endif
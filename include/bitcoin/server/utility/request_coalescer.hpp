@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_SERVER_REQUEST_COALESCER_HPP
+#define LIBBITCOIN_SERVER_REQUEST_COALESCER_HPP
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <bitcoin/bitcoin.hpp>
+#include <bitcoin/server/define.hpp>
+#include <bitcoin/server/messages/message.hpp>
+
+namespace libbitcoin {
+namespace server {
+
+/// This class is thread safe.
+/// Single-flight execution of identical read-only queries. A request that
+/// matches one in flight (by command, payload and cache epoch) is attached to
+/// it and answered from its response, so that one chain call serves all of
+/// them. A request in flight for longer than the timeout is not attached to,
+/// so a request that is never completed does not hold later requests, which
+/// instead answer its attached requests on completion.
+class BCS_API request_coalescer
+{
+public:
+    /// Construct an empty coalescer.
+    request_coalescer(const asio::duration& timeout);
+
+    /// This class is not copyable.
+    request_coalescer(const request_coalescer&) = delete;
+    void operator=(const request_coalescer&) = delete;
+
+    /// Attach the request to an identical request in flight and return true,
+    /// or return false and register the request, which the caller must then
+    /// execute and complete. The epoch is that of the response cache, so a
+    /// request following a reorganization is not attached to one preceding.
+    bool attach(const message& request, send_handler handler, size_t epoch);
+
+    /// As attach, at the given time.
+    bool attach(const message& request, send_handler handler, size_t epoch,
+        const asio::time_point& now);
+
+    /// Answer each request attached to the executed request and release it.
+    void complete(const message& request, size_t epoch,
+        message::chunk_ptr response);
+
+private:
+    typedef std::pair<message, send_handler> requester;
+    typedef std::vector<requester> requester_list;
+
+    struct pending
+    {
+        asio::time_point started;
+        requester_list requesters;
+    };
+
+    static std::string to_key(const message& request, size_t epoch);
+
+    const asio::duration timeout_;
+
+    // These are protected by mutex.
+    std::unordered_map<std::string, pending> pending_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace server
+} // namespace libbitcoin
+
+#endif
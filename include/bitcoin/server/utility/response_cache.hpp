@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_SERVER_RESPONSE_CACHE_HPP
+#define LIBBITCOIN_SERVER_RESPONSE_CACHE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <bitcoin/bitcoin.hpp>
+#include <bitcoin/server/define.hpp>
+
+namespace libbitcoin {
+namespace server {
+
+/// This class is thread safe.
+/// A size-bounded LRU cache of serialized query responses, keyed by command
+/// and request payload. Keys are distributed over independently locked
+/// shards so that concurrent queries rarely contend. Each response records
+/// the chain height on which it depends, so a reorganization discards only
+/// the responses above the fork point. Responses are shared by reference
+/// count, so a hit does not copy the response.
+class BCS_API response_cache
+{
+public:
+    typedef std::shared_ptr<const data_chunk> chunk_ptr;
+
+    /// The height of a response that depends on an unknown chain height.
+    static const size_t any_height;
+
+    /// Construct a cache of the given total size in bytes (zero disables).
+    response_cache(size_t capacity);
+
+    /// This class is not copyable.
+    response_cache(const response_cache&) = delete;
+    void operator=(const response_cache&) = delete;
+
+    /// True if the cache has capacity.
+    bool enabled() const;
+
+    /// The invalidation epoch, capture before the query that is stored.
+    size_t epoch() const;
+
+    /// Share the response to the request, true if found (counted).
+    bool find(chunk_ptr& out_response, const std::string& command,
+        const data_chunk& request);
+
+    /// Store the response to the request, unless invalidated since epoch.
+    void store(const std::string& command, const data_chunk& request,
+        chunk_ptr response, size_t height, size_t epoch);
+
+    /// Discard responses that depend on a height above the fork point.
+    void invalidate(size_t fork_height);
+
+    /// The number of found requests.
+    size_t hits() const;
+
+    /// The number of requests not found.
+    size_t misses() const;
+
+private:
+    struct entry
+    {
+        std::string key;
+        chunk_ptr response;
+        size_t height;
+    };
+
+    typedef std::list<entry> entry_list;
+
+    struct shard
+    {
+        // These are protected by mutex.
+        entry_list entries;
+        std::unordered_map<std::string, entry_list::iterator> keys;
+        size_t size = 0;
+        mutable std::mutex mutex;
+    };
+
+    static std::string to_key(const std::string& command,
+        const data_chunk& request);
+
+    shard& to_shard(const std::string& key);
+    void evict(shard& shard);
+
+    const size_t shard_capacity_;
+    std::vector<shard> shards_;
+    std::atomic<size_t> epoch_;
+    std::atomic<size_t> hits_;
+    std::atomic<size_t> misses_;
+};
+
+} // namespace server
+} // namespace libbitcoin
+
+#endif
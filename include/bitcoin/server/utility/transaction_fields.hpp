@@ -0,0 +1,102 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_SERVER_TRANSACTION_FIELDS_HPP
+#define LIBBITCOIN_SERVER_TRANSACTION_FIELDS_HPP
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <bitcoin/bitcoin.hpp>
+#include <bitcoin/server/define.hpp>
+
+namespace libbitcoin {
+namespace server {
+
+/// This class is thread safe.
+/// The payment address and stealth prefix fields of a transaction, extracted
+/// once by the server node and shared by each notification worker. The
+/// transaction is referenced, so its owner must outlive this object.
+class BCS_API transaction_fields
+{
+public:
+    typedef std::shared_ptr<const transaction_fields> const_ptr;
+    typedef std::vector<const_ptr> list;
+    typedef std::shared_ptr<const data_chunk> chunk_ptr;
+
+    /// The source of a field within the transaction.
+    enum class kind : uint8_t
+    {
+        /// The address of the input at index.
+        input = 0,
+
+        /// The address of the output at index.
+        output = 1,
+
+        /// The stealth prefix of the payment output at index.
+        stealth = 2
+    };
+
+    /// A payment address hash or stealth prefix and its location.
+    struct field
+    {
+        binary value;
+        transaction_fields::kind kind;
+        uint32_t index;
+    };
+
+    typedef std::vector<field> field_list;
+
+    /// Extract the fields of the transaction.
+    transaction_fields(const chain::transaction& tx);
+
+    /// This class is not copyable.
+    transaction_fields(const transaction_fields&) = delete;
+    void operator=(const transaction_fields&) = delete;
+
+    /// The transaction from which the fields were extracted.
+    const chain::transaction& transaction() const;
+
+    /// The payment address hashes and stealth prefixes of the transaction.
+    const field_list& fields() const;
+
+    /// The value of the output (or spent output) of the field, or
+    /// chain::output::not_found if the spent output is not cached.
+    uint64_t value(const field& field) const;
+
+    /// The serialized transaction, computed on first use.
+    const data_chunk& data() const;
+
+    /// The serialized transaction, shared for deferred use.
+    chunk_ptr shared_data() const;
+
+private:
+    static field_list extract(const chain::transaction& tx);
+
+    const chain::transaction& tx_;
+    const field_list fields_;
+
+    // These are protected by mutex.
+    mutable chunk_ptr data_;
+    mutable upgrade_mutex mutex_;
+};
+
+} // namespace server
+} // namespace libbitcoin
+
+#endif
@@ -19,14 +19,24 @@
 #ifndef LIBBITCOIN_SERVER_NOTIFICATION_WORKER_HPP
 #define LIBBITCOIN_SERVER_NOTIFICATION_WORKER_HPP
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <boost/filesystem.hpp>
 #include <bitcoin/bitcoin.hpp>
 #include <bitcoin/server/define.hpp>
 #include <bitcoin/server/messages/message.hpp>
+#include <bitcoin/server/messages/message_queue.hpp>
 #include <bitcoin/server/messages/route.hpp>
+#include <bitcoin/server/messages/route_queues.hpp>
 #include <bitcoin/server/settings.hpp>
-#include <bitcoin/server/utility/address_key.hpp>
+#include <bitcoin/server/utility/address_index.hpp>
+#include <bitcoin/server/utility/transaction_fields.hpp>
 
 namespace libbitcoin {
 namespace server {
@@ -53,7 +63,20 @@ public:
 
     /// Subscribe to address and stealth prefix notifications.
     virtual void subscribe_address(const route& reply_to, uint32_t id,
-        const binary& prefix_filter, bool unsubscribe);
+        const binary& prefix_filter, uint8_t options, bool unsubscribe);
+
+    /// Notify subscribers of the extracted transactions of a new block.
+    virtual void notify_block(uint32_t height, const hash_digest& block_hash,
+        const transaction_fields::list& txs);
+
+    /// Notify subscribers of the transactions of a block discarded by a
+    /// reorganization, at the height from which the block was removed.
+    virtual void notify_rollback(uint32_t height,
+        const hash_digest& block_hash, const transaction_fields::list& txs);
+
+    /// Notify subscribers of an extracted transaction (height zero if pool).
+    virtual void notify_transaction(uint32_t height,
+        const hash_digest& block_hash, const transaction_fields& tx);
 
     /////// Subscribe to transaction penetration notifications.
     ////virtual void subscribe_penetration(const route& reply_to, uint32_t id,
@@ -69,32 +92,35 @@ protected:
     virtual void work() override;
 
 private:
-    typedef std::shared_ptr<uint8_t> sequence_ptr;
+    typedef address_index::subscription subscription;
+    typedef std::vector<size_t> position_list;
+    typedef std::pair<subscription::ptr, position_list> match;
+    typedef std::vector<match> match_list;
+    typedef std::vector<match_list> block_matches;
+    typedef transaction_fields::chunk_ptr entry_ptr;
+    typedef std::vector<entry_ptr> entry_list;
+    typedef std::vector<std::pair<subscription::ptr, entry_list>> batch_list;
+    typedef std::unordered_map<subscription::ptr, entry_list> pool_batches;
 
     ////typedef notifier<address_key, const code&,
     ////    const wallet::payment_address&, int32_t, const hash_digest&,
     ////    transaction_const_ptr> payment_subscriber;
     ////typedef notifier<address_key, const code&, uint32_t, uint32_t,
     ////    const hash_digest&, transaction_const_ptr> stealth_subscriber;
-    typedef notifier<address_key, const code&, const binary&, uint32_t,
-        const hash_digest&, transaction_const_ptr> address_subscriber;
     ////typedef notifier<address_key, const code&, uint32_t,
     ////    const hash_digest&, const hash_digest&> penetration_subscriber;
 
     // Remove expired subscriptions.
     void purge();
-    int32_t purge_interval_milliseconds() const;
 
-    ////bool handle_inventories(const code& ec, inventory_const_ptr packet);
-    bool handle_reorganization(const code& ec, size_t fork_height,
-        block_const_ptr_list_const_ptr new_blocks,
-        block_const_ptr_list_const_ptr old_blocks);
-    bool handle_transaction_pool(const code& ec, transaction_const_ptr tx);
+    // Save and restore subscriptions across restarts.
+    boost::filesystem::path snapshot_file() const;
+    void load_snapshot();
+    bool save_snapshot();
+    bool write_snapshot() const;
 
+    ////bool handle_inventories(const code& ec, inventory_const_ptr packet);
     ////void notify_inventory(const bc::message::inventory_vector& inventory);
-    void notify_block(uint32_t height, block_const_ptr block);
-    void notify_transaction(uint32_t height, const hash_digest& block_hash,
-        transaction_const_ptr tx);
 
     ////// v2/v3 (deprecated)
     ////void notify_payment(const wallet::payment_address& address,
@@ -104,23 +130,44 @@ private:
     ////    const hash_digest& block_hash, transaction_const_ptr tx);
 
     // v3
-    void notify_address(const libbitcoin::binary& field, uint32_t height,
-        const hash_digest& block_hash, transaction_const_ptr tx);
+    void match_transaction(const transaction_fields& tx,
+        match_list& matches) const;
+    block_matches match_block(const transaction_fields::list& txs) const;
+    static entry_ptr to_entry(subscription& subscriber, uint32_t height,
+        const transaction_fields& tx, const position_list& positions);
     ////void notify_penetration(uint32_t height, const hash_digest& block_hash,
     ////    const hash_digest& tx_hash);
 
-    // Send a notification to the subscriber.
+    // Send queued notifications on the worker socket, returns the count.
+    size_t drain(socket& router);
+
+    // Hold the queue of a client reported at high water by the service.
+    void receive(socket& router);
+
+    // The poller wait for the next timer event.
+    static int32_t wait_milliseconds(const asio::time_point& deadline);
+
+    // Log client and outbox queue statistics.
+    void report();
+
+    // Queue a notification to the subscriber.
     void send(const route& reply_to, const std::string& command,
-        uint32_t id, const data_chunk& payload);
+        uint32_t id, data_chunk&& payload);
+    void send_error(const subscription::list& subscriptions, const code& ec);
     ////void send_payment(const route& reply_to, uint32_t id,
     ////    const wallet::payment_address& address, uint32_t height,
     ////    const hash_digest& block_hash, transaction_const_ptr tx);
     ////void send_stealth(const route& reply_to, uint32_t id, uint32_t prefix,
     ////    uint32_t height, const hash_digest& block_hash,
     ////    transaction_const_ptr tx);
-    void send_address(const route& reply_to, uint32_t id, uint8_t sequence,
-        uint32_t height, const hash_digest& block_hash,
-        transaction_const_ptr tx);
+    void send_address(subscription& subscriber, uint32_t height,
+        const hash_digest& block_hash, const data_chunk& tx);
+    void send_entries(subscription& subscriber, uint32_t height,
+        const hash_digest& block_hash, const entry_list& entries);
+    void send_pool_batches();
+    void send_rollback(subscription& subscriber, uint32_t height,
+        const hash_digest& block_hash, const hash_list& tx_hashes);
+    static const std::string& update_command(uint8_t options);
 
     ////bool handle_payment(const code& ec, const wallet::payment_address& address,
     ////    uint32_t height, const hash_digest& block_hash,
@@ -129,10 +176,6 @@ private:
     ////bool handle_stealth(const code& ec, uint32_t prefix, uint32_t height,
     ////    const hash_digest& block_hash, transaction_const_ptr tx,
     ////    const route& reply_to, uint32_t id, const binary& prefix_filter);
-    bool handle_address(const code& ec, const binary& field, uint32_t height,
-        const hash_digest& block_hash, transaction_const_ptr tx,
-        const route& reply_to, uint32_t id, const libbitcoin::binary& prefix_filter,
-        sequence_ptr sequence);
 
     const bool secure_;
     const server::settings& settings_;
@@ -140,7 +183,19 @@ private:
     // These are thread safe.
     server_node& node_;
     bc::protocol::zmq::authenticator& authenticator_;
-    address_subscriber::ptr address_subscriber_;
+    address_index address_index_;
+    message_queue outbox_;
+
+    // This is used only on the worker thread.
+    route_queues clients_;
+
+    // This is protected by mutex.
+    bool snapshot_saved_;
+    std::mutex snapshot_mutex_;
+
+    // This is protected by mutex.
+    pool_batches pool_batches_;
+    std::mutex pool_batch_mutex_;
     ////payment_subscriber::ptr payment_subscriber_;
     ////stealth_subscriber::ptr stealth_subscriber_;
     ////penetration_subscriber::ptr penetration_subscriber_;
@@ -19,6 +19,8 @@
 #ifndef LIBBITCOIN_SERVER_QUERY_WORKER_HPP
 #define LIBBITCOIN_SERVER_QUERY_WORKER_HPP
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <functional>
 #include <string>
@@ -26,6 +28,8 @@
 #include <bitcoin/protocol.hpp>
 #include <bitcoin/server/define.hpp>
 #include <bitcoin/server/messages/message.hpp>
+#include <bitcoin/server/messages/message_queue.hpp>
+#include <bitcoin/server/services/query_service.hpp>
 #include <bitcoin/server/settings.hpp>
 
 namespace libbitcoin {
@@ -41,9 +45,10 @@ class BCS_API query_worker
 public:
     typedef std::shared_ptr<query_worker> ptr;
 
-    /// Construct a query worker.
+    /// Construct a query worker for the lane of the query service shard.
     query_worker(bc::protocol::zmq::authenticator& authenticator,
-        server_node& node, bool secure);
+        server_node& node, bool secure, query_service::lane lane,
+        uint16_t shard);
 
 protected:
     typedef bc::protocol::zmq::socket socket;
@@ -62,7 +67,16 @@ protected:
     virtual void work();
 
 private:
+    // Send completed queries on the worker socket, returns the count.
+    size_t drain(socket& router);
+
+    // Execute the request, via the response cache if cacheable.
+    void execute(const command_handler& handler, const message& request,
+        send_handler sender);
+
     const bool secure_;
+    const query_service::lane lane_;
+    const uint16_t shard_;
     const bool verbose_;
     const server::settings& settings_;
 
@@ -72,6 +86,9 @@ private:
 
     // This is protected by base class mutex.
     command_map command_handlers_;
+
+    // Completions are queued from any thread and sent on the worker thread.
+    message_queue completions_;
 };
 
 } // namespace server
@@ -18,11 +18,14 @@
  */
 #include <bitcoin/server/interface/address.hpp>
 
+#include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <iterator>
 #include <bitcoin/bitcoin.hpp>
 #include <bitcoin/server/messages/message.hpp>
 #include <bitcoin/server/server_node.hpp>
+#include <bitcoin/server/utility/address_index.hpp>
 #include <bitcoin/server/utility/fetch_helpers.hpp>
 
 namespace libbitcoin {
@@ -32,6 +35,8 @@ using namespace std::placeholders;
 using namespace bc::chain;
 using namespace bc::wallet;
 
+typedef address_index::subscription subscription;
+
 // Transaction pool address history is not indexed.
 ////void address::fetch_history2(server_node& node, const message& request,
 ////    send_handler handler)
@@ -64,7 +69,26 @@ void address::subscribe2(server_node& node, const message& request,
         return;
     }
 
-    node.subscribe_address(request.route(), request.id(), prefix_filter, false);
+    node.subscribe_address(request.route(), request.id(), prefix_filter,
+        subscription::none, false);
+    handler(message(request, error::success));
+}
+
+// Options are fixed by the initial subscription, renewal may use subscribe2.
+void address::subscribe3(server_node& node, const message& request,
+    send_handler handler)
+{
+    uint8_t options;
+    binary prefix_filter;
+
+    if (!unwrap_subscribe3_args(prefix_filter, options, request))
+    {
+        handler(message(request, error::bad_stream));
+        return;
+    }
+
+    node.subscribe_address(request.route(), request.id(), prefix_filter,
+        options, false);
     handler(message(request, error::success));
 }
 
@@ -80,7 +104,8 @@ void address::unsubscribe2(server_node& node, const message& request,
         return;
     }
 
-    node.subscribe_address(request.route(), request.id(), prefix_filter, true);
+    node.subscribe_address(request.route(), request.id(), prefix_filter,
+        subscription::none, true);
     handler(message(request, error::success));
 }
 
@@ -90,12 +115,40 @@ bool address::unwrap_subscribe2_args(binary& prefix_filter,
     // [ prefix_bitsize:1 ]
     // [ prefix_blocks:...]
     const auto& data = request.data();
+    return unwrap_prefix(prefix_filter, data.begin(), data.end());
+}
+
+bool address::unwrap_subscribe3_args(binary& prefix_filter, uint8_t& options,
+    const message& request)
+{
+    // [ options:1 ]
+    // [ prefix_bitsize:1 ]
+    // [ prefix_blocks:...]
+    const auto& data = request.data();
 
     if (data.empty())
         return false;
 
+    static const uint8_t supported = subscription::batch |
+        subscription::compact;
+
+    // Reject unknown options so that they may be defined later.
+    options = data[0];
+
+    if ((options & ~supported) != 0)
+        return false;
+
+    return unwrap_prefix(prefix_filter, data.begin() + 1, data.end());
+}
+
+bool address::unwrap_prefix(binary& prefix_filter,
+    data_chunk::const_iterator begin, data_chunk::const_iterator end)
+{
+    if (begin == end)
+        return false;
+
     // First byte is the number of bits.
-    auto bit_length = data[0];
+    auto bit_length = *begin;
 
     //// The max byte value is 255, so this is unnecessary.
     ////static constexpr size_t address_bits = hash_size * byte_bits;
@@ -105,10 +158,10 @@ bool address::unwrap_subscribe2_args(binary& prefix_filter,
     // Convert the bit length to byte length.
     const auto byte_length = binary::blocks_size(bit_length);
 
-    if (data.size() - 1 != byte_length)
+    if (static_cast<size_t>(std::distance(begin, end)) - 1 != byte_length)
         return false;
 
-    const data_chunk bytes({ data.begin() + 1, data.end() });
+    const data_chunk bytes({ begin + 1, end });
     prefix_filter = binary(bit_length, bytes);
     return true;
 }
@@ -18,14 +18,27 @@
  */
 #include <bitcoin/server/interface/blockchain.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <cstddef>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
 #include <bitcoin/blockchain.hpp>
 #include <bitcoin/server/define.hpp>
 #include <bitcoin/server/messages/message.hpp>
 #include <bitcoin/server/server_node.hpp>
+#include <bitcoin/server/utility/chain_tip.hpp>
 #include <bitcoin/server/utility/fetch_helpers.hpp>
+#include <bitcoin/server/utility/output_cache.hpp>
+#include <bitcoin/server/utility/parallel.hpp>
+#include <bitcoin/server/utility/query_task.hpp>
+
+// Defines the reenter and yield keywords of boost::asio::coroutine.
+#include <boost/asio/yield.hpp>
 
 namespace libbitcoin {
 namespace server {
@@ -57,6 +70,524 @@ void blockchain::fetch_history2(server_node& node, const message& request,
             _1, _2, request, handler));
 }
 
+// blockchain.fetch_history3
+// ----------------------------------------------------------------------------
+
+// The maximum number of addresses of a batched history query.
+static constexpr size_t max_history_addresses = 1000;
+
+// The maximum number of rows of a batched history query, past which the query
+// fails (operation_failed) and the client pages the addresses individually.
+static constexpr size_t max_history_rows = 100000;
+
+// The histories of a batch, completed by any thread in any order.
+struct history_batch
+{
+    history_batch(const message& request, send_handler handler,
+        payment_address::list&& addresses, bool posted)
+      : request(request), handler(handler), addresses(std::move(addresses)),
+        histories(this->addresses.size()), remaining(this->addresses.size()),
+        rows(0), posted(posted)
+    {
+    }
+
+    const message request;
+    const send_handler handler;
+    const payment_address::list addresses;
+    std::vector<history_compact::list> histories;
+    std::atomic<size_t> remaining;
+    std::atomic<size_t> rows;
+    const bool posted;
+
+    // This is protected by mutex.
+    code ec;
+    std::mutex mutex;
+};
+
+// Rows are merged by height, and by request order within a height.
+static void send_history_batch(history_batch& batch)
+{
+    static constexpr size_t row_size = index_size + sizeof(uint8_t) +
+        point_size + sizeof(uint32_t) + sizeof(uint64_t);
+
+    typedef std::pair<uint32_t, const history_compact*> indexed_row;
+    std::vector<indexed_row> rows;
+
+    if (!batch.ec)
+    {
+        for (size_t index = 0; index < batch.histories.size(); ++index)
+            for (const auto& row: batch.histories[index])
+                rows.emplace_back(static_cast<uint32_t>(index), &row);
+
+        const auto lower = [](const indexed_row& left,
+            const indexed_row& right)
+        {
+            return left.second->height < right.second->height;
+        };
+
+        std::stable_sort(rows.begin(), rows.end(), lower);
+    }
+
+    // [ code:4 ]
+    // [[ index:4 ][ kind:1 ][ point:36 ][ height:4 ][ value:8 ]...]
+    data_chunk result(code_size + row_size * rows.size());
+    auto serial = make_unsafe_serializer(result.begin());
+    serial.write_error_code(batch.ec);
+
+    for (const auto& row: rows)
+    {
+        BITCOIN_ASSERT(row.second->height <= max_uint32);
+        serial.write_4_bytes_little_endian(row.first);
+        serial.write_byte(static_cast<uint8_t>(row.second->kind));
+        serial.write_hash(row.second->point.hash());
+        serial.write_4_bytes_little_endian(row.second->point.index());
+        serial.write_4_bytes_little_endian(row.second->height);
+        serial.write_8_bytes_little_endian(row.second->value);
+    }
+
+    batch.handler(message(batch.request, std::move(result)));
+}
+
+bool blockchain::unwrap_fetch_history3_args(payment_address::list& addresses,
+    size_t& from_height, const message& request)
+{
+    static constexpr size_t entry_size = sizeof(uint8_t) + short_hash_size;
+
+    // [ from_height:4 ]
+    // [ count:varint ]
+    // [[ version:1 ][ address_hash:20 ]...]
+    const auto& data = request.data();
+    auto deserial = make_safe_deserializer(data.begin(), data.end());
+    from_height = deserial.read_4_bytes_little_endian();
+    const auto count = deserial.read_size_little_endian();
+
+    if (!deserial || count == 0 || count > max_history_addresses ||
+        data.size() != sizeof(uint32_t) + variable_uint_size(count) +
+            count * entry_size)
+        return false;
+
+    addresses.reserve(count);
+
+    for (size_t index = 0; index < count; ++index)
+    {
+        const auto version_byte = deserial.read_byte();
+        const auto hash = deserial.read_short_hash();
+        addresses.emplace_back(hash, version_byte);
+    }
+
+    return true;
+}
+
+// The fetches are posted to the threadpool in query_parallelism ranges, so
+// the query worker is not held, and the last to complete sends the response.
+// Only a limited number of batches are posted at once, so that history reads
+// cannot occupy the threads of the node. Other batches are read on the query
+// worker, as is fetch_history2. No read exceeds the row limit of the batch,
+// and reads are skipped once the batch has exceeded it.
+void blockchain::fetch_history3(server_node& node, const message& request,
+    send_handler handler)
+{
+    static constexpr size_t limit = max_history_rows + 1;
+    size_t from_height;
+    payment_address::list addresses;
+
+    if (!unwrap_fetch_history3_args(addresses, from_height, request))
+    {
+        handler(message(request, error::bad_stream));
+        return;
+    }
+
+    LOG_DEBUG(LOG_SERVER)
+        << "blockchain.fetch_history3(" << addresses.size()
+        << " addresses, from_height=" << from_height << ")";
+
+    const auto count = addresses.size();
+    const auto posted = node.history_batches().try_acquire();
+    const auto batch = std::make_shared<history_batch>(request, handler,
+        std::move(addresses), posted);
+
+    const auto fetch = [&node, from_height, batch](size_t first, size_t last)
+    {
+        for (auto index = first; index < last; ++index)
+        {
+            const auto fetched = [&node, batch, index](const code& ec,
+                const history_compact::list& history)
+            {
+                const auto failure = ec ? ec :
+                    (batch->rows += history.size()) > max_history_rows ?
+                        code(error::operation_failed) : code();
+
+                if (failure)
+                {
+                    std::lock_guard<std::mutex> lock(batch->mutex);
+                    batch->ec = failure;
+                }
+                else
+                {
+                    batch->histories[index] = history;
+                }
+
+                if (--batch->remaining > 0)
+                    return;
+
+                send_history_batch(*batch);
+
+                if (batch->posted)
+                    node.history_batches().release();
+            };
+
+            if (batch->rows.load() > max_history_rows)
+                fetched(error::operation_failed, {});
+            else
+                node.chain().fetch_history(batch->addresses[index], limit,
+                    from_height, fetched);
+        }
+    };
+
+    if (!posted)
+    {
+        fetch(0, count);
+        return;
+    }
+
+    parallel_post(node.thread_pool(), count,
+        node.server_settings().query_parallelism, fetch);
+}
+
+// blockchain.fetch_history4
+// ----------------------------------------------------------------------------
+
+// The maximum number of rows of a history page.
+static constexpr size_t max_history_page = 10000;
+
+// The maximum offset + rows of a history page. The chain cannot resume a
+// history read from a key, so each page rereads the rows that precede it,
+// and this bounds that read. A client given a next offset at this bound
+// reads the remainder of the history with fetch_history2.
+static constexpr size_t max_history_offset = 100000;
+
+// A page is read from the chain with a limit of offset + rows, so no request
+// reads more than its page and the rows that precede it, and nothing is held
+// between requests. The chain returns rows most recent first, so rows
+// confirmed while paging shift later pages to repeat (not skip) rows of
+// earlier pages, which a client may drop by point.
+static void send_history_page(const code& ec,
+    const history_compact::list& history, uint32_t offset, uint32_t rows,
+    const message& request, send_handler handler)
+{
+    static constexpr size_t row_size = sizeof(uint8_t) + point_size +
+        sizeof(uint32_t) + sizeof(uint64_t);
+
+    if (ec)
+    {
+        handler(message(request, ec));
+        return;
+    }
+
+    const auto first = std::min(size_t(offset), history.size());
+    const auto last = history.size();
+    BITCOIN_ASSERT(last - first <= rows);
+
+    // A full page may be followed by another, zero is the end of history.
+    const auto next = last - first == rows ? offset + rows : 0;
+
+    // [ code:4 ]
+    // [ next_offset:4 ]
+    // [[ kind:1 ][ point:36 ][ height:4 ][ value:8 ]...]
+    data_chunk result(code_size + sizeof(uint32_t) +
+        row_size * (last - first));
+    auto serial = make_unsafe_serializer(result.begin());
+    serial.write_error_code(error::success);
+    serial.write_4_bytes_little_endian(next);
+
+    for (auto index = first; index < last; ++index)
+    {
+        const auto& row = history[index];
+        BITCOIN_ASSERT(row.height <= max_uint32);
+        serial.write_byte(static_cast<uint8_t>(row.kind));
+        serial.write_hash(row.point.hash());
+        serial.write_4_bytes_little_endian(row.point.index());
+        serial.write_4_bytes_little_endian(row.height);
+        serial.write_8_bytes_little_endian(row.value);
+    }
+
+    handler(message(request, std::move(result)));
+}
+
+bool blockchain::unwrap_fetch_history4_args(payment_address& address,
+    size_t& from_height, uint32_t& offset, uint32_t& rows,
+    const message& request)
+{
+    static constexpr size_t history4_args_size = sizeof(uint8_t) +
+        short_hash_size + sizeof(uint32_t) + sizeof(uint32_t) +
+        sizeof(uint32_t);
+
+    // [ version:1 ]
+    // [ address_hash:20 ]
+    // [ from_height:4 ]
+    // [ offset:4 ]
+    // [ rows:4 ]
+    const auto& data = request.data();
+
+    if (data.size() != history4_args_size)
+        return false;
+
+    auto deserial = make_safe_deserializer(data.begin(), data.end());
+    const auto version_byte = deserial.read_byte();
+    const auto hash = deserial.read_short_hash();
+    from_height = deserial.read_4_bytes_little_endian();
+    offset = deserial.read_4_bytes_little_endian();
+    rows = deserial.read_4_bytes_little_endian();
+    address = payment_address(hash, version_byte);
+
+    return rows > 0 && rows <= max_history_page &&
+        offset <= max_history_offset - rows;
+}
+
+void blockchain::fetch_history4(server_node& node, const message& request,
+    send_handler handler)
+{
+    uint32_t rows;
+    uint32_t offset;
+    size_t from_height;
+    payment_address address;
+
+    if (!unwrap_fetch_history4_args(address, from_height, offset, rows,
+        request))
+    {
+        handler(message(request, error::bad_stream));
+        return;
+    }
+
+    LOG_DEBUG(LOG_SERVER)
+        << "blockchain.fetch_history4(" << address.encoded()
+        << ", from_height=" << from_height << ", offset=" << offset
+        << ", rows=" << rows << ")";
+
+    const size_t limit = size_t(offset) + rows;
+    node.chain().fetch_history(address, limit, from_height,
+        std::bind(send_history_page,
+            _1, _2, offset, rows, request, handler));
+}
+
+// blockchain.fetch_balance/fetch_unspent_outputs
+// ----------------------------------------------------------------------------
+
+// The top height is read from the tip once set (at startup), and the
+// outputs of the address are read from the cache, or computed from its
+// history and cached. An output or spend is confirmed by the number of
+// blocks from its block to the top (inclusive), so zero confirmations
+// includes all. An output spent above the depth is unspent at that depth.
+class address_outputs_task
+  : public query_task<address_outputs_task>
+{
+public:
+    address_outputs_task(server_node& node, const message& request,
+        send_handler handler, const payment_address& address,
+        uint32_t min_confirmations, bool unspent)
+      : node_(node), request_(request), handler_(handler), address_(address),
+        min_confirmations_(min_confirmations), unspent_(unspent), top_(0),
+        epoch_(0)
+    {
+    }
+
+private:
+    friend class query_task<address_outputs_task>;
+
+    void receive(const code& ec, size_t top)
+    {
+        ec_ = ec;
+        top_ = top;
+    }
+
+    void receive(const code& ec, const history_compact::list& history)
+    {
+        ec_ = ec;
+
+        if (!ec)
+            outputs_ = output_cache::to_outputs(history);
+    }
+
+    void resume()
+    {
+        static constexpr size_t limit = 0;
+        static constexpr size_t from_height = 0;
+
+        reenter(this)
+        {
+            tip_ = node_.tip().get();
+
+            if (tip_)
+                top_ = tip_->height;
+            else
+                yield node_.chain().fetch_last_height(next());
+
+            if (!ec_)
+                outputs_ = node_.outputs().find(address_.hash());
+
+            if (!ec_ && !outputs_)
+            {
+                // The epoch precedes the read so a block in flight is detected.
+                epoch_ = node_.outputs().epoch();
+
+                yield node_.chain().fetch_history(address_, limit,
+                    from_height, next());
+
+                if (!ec_)
+                    node_.outputs().store(address_.hash(), outputs_, epoch_);
+            }
+
+            if (ec_)
+                handler_(message(request_, ec_));
+            else if (unspent_)
+                send_unspent();
+            else
+                send_balance();
+        }
+    }
+
+    bool is_confirmed(size_t height) const
+    {
+        const auto confirmations = height > top_ ? 0 : top_ - height + 1;
+        return confirmations >= min_confirmations_;
+    }
+
+    bool is_spent(const output_cache::output& output) const
+    {
+        return output.spent && is_confirmed(output.spent_height);
+    }
+
+    void send_balance()
+    {
+        uint64_t received = 0;
+        uint64_t spent = 0;
+
+        for (const auto& output: *outputs_)
+        {
+            if (!is_confirmed(output.height))
+                continue;
+
+            received = ceiling_add(received, output.value);
+
+            if (is_spent(output))
+                spent = ceiling_add(spent, output.value);
+        }
+
+        // [ code:4 ]
+        // [ balance:8 ]
+        // [ received:8 ]
+        // [ spent:8 ]
+        data_chunk result(code_size + 3 * sizeof(uint64_t));
+        auto serial = make_unsafe_serializer(result.begin());
+        serial.write_error_code(error::success);
+        serial.write_8_bytes_little_endian(received - spent);
+        serial.write_8_bytes_little_endian(received);
+        serial.write_8_bytes_little_endian(spent);
+
+        handler_(message(request_, std::move(result)));
+    }
+
+    void send_unspent()
+    {
+        static constexpr size_t row_size = point_size + sizeof(uint32_t) +
+            sizeof(uint64_t);
+
+        const auto unspent = [this](const output_cache::output& output)
+        {
+            return !is_spent(output) && is_confirmed(output.height);
+        };
+
+        const auto count = static_cast<size_t>(std::count_if(
+            outputs_->begin(), outputs_->end(), unspent));
+
+        // [ code:4 ]
+        // [[ point:36 ][ height:4 ][ value:8 ]...]
+        data_chunk result(code_size + row_size * count);
+        auto serial = make_unsafe_serializer(result.begin());
+        serial.write_error_code(error::success);
+
+        for (const auto& output: *outputs_)
+        {
+            if (!unspent(output))
+                continue;
+
+            BITCOIN_ASSERT(output.height <= max_uint32);
+            serial.write_hash(output.point.hash());
+            serial.write_4_bytes_little_endian(output.point.index());
+            serial.write_4_bytes_little_endian(output.height);
+            serial.write_8_bytes_little_endian(output.value);
+        }
+
+        handler_(message(request_, std::move(result)));
+    }
+
+    server_node& node_;
+    const message request_;
+    const send_handler handler_;
+    const payment_address address_;
+    const uint32_t min_confirmations_;
+    const bool unspent_;
+    chain_tip::ptr tip_;
+    size_t top_;
+    size_t epoch_;
+    output_cache::list_ptr outputs_;
+    code ec_;
+};
+
+bool blockchain::unwrap_fetch_outputs_args(payment_address& address,
+    uint32_t& min_confirmations, const message& request)
+{
+    static constexpr size_t outputs_args_size = sizeof(uint8_t) +
+        short_hash_size + sizeof(uint32_t);
+
+    // [ version:1 ]
+    // [ address_hash:20 ]
+    // [ min_confirmations:4 ]
+    const auto& data = request.data();
+
+    if (data.size() != outputs_args_size)
+        return false;
+
+    auto deserial = make_safe_deserializer(data.begin(), data.end());
+    const auto version_byte = deserial.read_byte();
+    const auto hash = deserial.read_short_hash();
+    min_confirmations = deserial.read_4_bytes_little_endian();
+    address = payment_address(hash, version_byte);
+    return true;
+}
+
+void blockchain::fetch_balance(server_node& node, const message& request,
+    send_handler handler)
+{
+    uint32_t min_confirmations;
+    payment_address address;
+
+    if (!unwrap_fetch_outputs_args(address, min_confirmations, request))
+    {
+        handler(message(request, error::bad_stream));
+        return;
+    }
+
+    address_outputs_task::start(node, request, handler, address,
+        min_confirmations, false);
+}
+
+void blockchain::fetch_unspent_outputs(server_node& node,
+    const message& request, send_handler handler)
+{
+    uint32_t min_confirmations;
+    payment_address address;
+
+    if (!unwrap_fetch_outputs_args(address, min_confirmations, request))
+    {
+        handler(message(request, error::bad_stream));
+        return;
+    }
+
+    address_outputs_task::start(node, request, handler, address,
+        min_confirmations, true);
+}
+
 void blockchain::fetch_transaction(server_node& node, const message& request,
     send_handler handler)
 {
@@ -88,6 +619,15 @@ void blockchain::fetch_last_height(server_node& node, const message& request,
         return;
     }
 
+    // The tip is read from memory once set (at startup).
+    const auto tip = node.tip().get();
+
+    if (tip)
+    {
+        last_height_fetched(error::success, tip->height, request, handler);
+        return;
+    }
+
     node.chain().fetch_last_height(
         std::bind(&blockchain::last_height_fetched,
             _1, _2, request, handler));
@@ -101,122 +641,437 @@ void blockchain::last_height_fetched(const code& ec, size_t last_height,
 
     // [ code:4 ]
     // [ heigh:4 ]
-    const auto result = build_chunk(
-    {
-        message::to_bytes(ec),
-        to_little_endian(last_height32)
-    });
+    data_chunk result(code_size + sizeof(uint32_t));
+    auto serial = make_unsafe_serializer(result.begin());
+    serial.write_error_code(ec);
+    serial.write_4_bytes_little_endian(last_height32);
 
-    handler(message(request, result));
+    handler(message(request, std::move(result)));
 }
 
-void blockchain::fetch_block_header(server_node& node, const message& request,
-    send_handler handler)
+// The tip is read from memory once set. If it could not be read at startup,
+// it is read from the chain here and set (unless since set by a
+// reorganization), so that later requests are served from memory.
+class tip_task
+  : public query_task<tip_task>
 {
-    const auto& data = request.data();
+public:
+    tip_task(server_node& node, const message& request, send_handler handler)
+      : node_(node), request_(request), handler_(handler), height_(0)
+    {
+    }
 
-    if (data.size() == hash_size)
-        blockchain::fetch_block_header_by_hash(node, request, handler);
-    else if (data.size() == sizeof(uint32_t))
-        blockchain::fetch_block_header_by_height(node, request, handler);
-    else
-        handler(message(request, error::bad_stream));
-}
+private:
+    friend class query_task<tip_task>;
 
-void blockchain::fetch_block_header_by_hash(server_node& node,
-    const message& request, send_handler handler)
+    void receive(const code& ec, size_t height)
+    {
+        ec_ = ec;
+        height_ = height;
+    }
+
+    void receive(const code& ec, header_const_ptr header)
+    {
+        ec_ = ec;
+        header_ = header;
+    }
+
+    void resume()
+    {
+        reenter(this)
+        {
+            tip_ = node_.tip().get();
+
+            if (!tip_)
+            {
+                yield node_.chain().fetch_last_height(next());
+
+                if (!ec_)
+                    yield node_.chain().fetch_block_header(height_, next());
+
+                if (!ec_)
+                {
+                    node_.tip().initialize(height_, *header_);
+                    tip_ = node_.tip().get();
+                }
+            }
+
+            send();
+        }
+    }
+
+    void send()
+    {
+        if (ec_)
+        {
+            handler_(message(request_, ec_));
+            return;
+        }
+
+        BITCOIN_ASSERT(tip_->height <= max_uint32);
+        const auto height32 = static_cast<uint32_t>(tip_->height);
+
+        // [ code:4 ]
+        // [ height:4 ]
+        // [ hash:32 ]
+        // [ header:80 ]
+        data_chunk result(code_size + sizeof(uint32_t) + hash_size +
+            tip_->header.serialized_size());
+        auto serial = make_unsafe_serializer(result.begin());
+        serial.write_error_code(error::success);
+        serial.write_4_bytes_little_endian(height32);
+        serial.write_hash(tip_->hash);
+        tip_->header.to_data(serial);
+
+        handler_(message(request_, std::move(result)));
+    }
+
+    server_node& node_;
+    const message request_;
+    const send_handler handler_;
+    chain_tip::ptr tip_;
+    size_t height_;
+    header_const_ptr header_;
+    code ec_;
+};
+
+void blockchain::fetch_tip(server_node& node, const message& request,
+    send_handler handler)
 {
-    const auto& data = request.data();
-    BITCOIN_ASSERT(data.size() == hash_size);
+    if (!request.data().empty())
+    {
+        handler(message(request, error::bad_stream));
+        return;
+    }
 
-    auto deserial = make_safe_deserializer(data.begin(), data.end());
-    const auto block_hash = deserial.read_hash();
+    tip_task::start(node, request, handler);
+}
 
-    node.chain().fetch_block_header(block_hash,
-        std::bind(&blockchain::block_header_fetched,
-            _1, _2, request, handler));
+// Block queries are by hash or height (conditional serialization).
+static bool is_block_key(const data_chunk& data)
+{
+    return data.size() == hash_size || data.size() == sizeof(uint32_t);
 }
 
-void blockchain::fetch_block_header_by_height(server_node& node,
-    const message& request, send_handler handler)
+// blockchain.fetch_block_header
+// ----------------------------------------------------------------------------
+
+class block_header_task
+  : public query_task<block_header_task>
 {
-    const auto& data = request.data();
-    BITCOIN_ASSERT(data.size() == sizeof(uint32_t));
+public:
+    block_header_task(server_node& node, const message& request,
+        send_handler handler)
+      : node_(node), request_(request), handler_(handler)
+    {
+    }
 
-    auto deserial = make_safe_deserializer(data.begin(), data.end());
-    const uint64_t height = deserial.read_4_bytes_little_endian();
+private:
+    friend class query_task<block_header_task>;
 
-    node.chain().fetch_block_header(height,
-        std::bind(&blockchain::block_header_fetched,
-            _1, _2, request, handler));
-}
+    void receive(const code& ec, header_const_ptr header)
+    {
+        ec_ = ec;
+        header_ = header;
+    }
 
-void blockchain::block_header_fetched(const code& ec, header_const_ptr header,
-    const message& request, send_handler handler)
+    void fetch()
+    {
+        const auto& data = request_.data();
+        auto deserial = make_safe_deserializer(data.begin(), data.end());
+
+        if (data.size() == hash_size)
+            node_.chain().fetch_block_header(deserial.read_hash(), next());
+        else
+            node_.chain().fetch_block_header(
+                size_t(deserial.read_4_bytes_little_endian()), next());
+    }
+
+    void resume()
+    {
+        reenter(this)
+        {
+            yield fetch();
+            send();
+        }
+    }
+
+    void send()
+    {
+        // [ code:4 ]
+        // [ block... ]
+        data_chunk result(code_size +
+            (ec_ ? 0 : header_->serialized_size(false)));
+        auto serial = make_unsafe_serializer(result.begin());
+        serial.write_error_code(ec_);
+
+        if (!ec_)
+            header_->to_data(serial, false);
+
+        handler_(message(request_, std::move(result)));
+    }
+
+    server_node& node_;
+    const message request_;
+    const send_handler handler_;
+    header_const_ptr header_;
+    code ec_;
+};
+
+void blockchain::fetch_block_header(server_node& node, const message& request,
+    send_handler handler)
 {
-    // [ code:4 ]
-    // [ block... ]
-    const auto result = build_chunk(
+    if (!is_block_key(request.data()))
     {
-        message::to_bytes(ec),
-        header->to_data(false)
-    });
+        handler(message(request, error::bad_stream));
+        return;
+    }
 
-    handler(message(request, result));
+    block_header_task::start(node, request, handler);
 }
 
-void blockchain::fetch_block_transaction_hashes(server_node& node,
-    const message& request, send_handler handler)
+// blockchain.fetch_block_headers
+// ----------------------------------------------------------------------------
+
+// The maximum number of headers of a response (as with p2p getheaders).
+static constexpr size_t max_block_headers = 2000;
+
+// The maximum number of locator hashes, each a chain read (as with p2p).
+static constexpr size_t max_locator_hashes = 500;
+
+// The serialized size of a header (without transaction count).
+static constexpr size_t block_header_size = 80;
+
+// The locator is of the form of p2p getheaders, most recent hash first.
+// The range begins above the first located hash, or at genesis if none.
+// The range ends at the requested count or the top of the chain.
+class block_headers_task
+  : public query_task<block_headers_task>
 {
-    const auto& data = request.data();
+public:
+    block_headers_task(server_node& node, const message& request,
+        send_handler handler, uint32_t from_height, uint32_t count,
+        hash_list&& locator)
+      : node_(node), request_(request), handler_(handler),
+        from_height_(from_height), count_(count), index_(0),
+        locator_(std::move(locator)), height_(0)
+    {
+    }
 
-    if (data.size() == hash_size)
-        fetch_block_transaction_hashes_by_hash(node, request, handler);
-    else if (data.size() == sizeof(uint32_t))
-        fetch_block_transaction_hashes_by_height(node, request, handler);
-    else
-        handler(message(request, error::bad_stream));
-}
+private:
+    friend class query_task<block_headers_task>;
 
-void blockchain::fetch_block_transaction_hashes_by_hash(server_node& node,
-    const message& request, send_handler handler)
+    void receive(const code& ec, size_t height)
+    {
+        ec_ = ec;
+        height_ = height;
+    }
+
+    void receive(const code& ec, header_const_ptr header)
+    {
+        ec_ = ec;
+        header_ = header;
+    }
+
+    void resume()
+    {
+        reenter(this)
+        {
+            for (index_ = 0; index_ < locator_.size(); ++index_)
+            {
+                yield node_.chain().fetch_block_height(locator_[index_],
+                    next());
+
+                if (!ec_)
+                {
+                    from_height_ = safe_unsigned<uint32_t>(height_ + 1);
+                    break;
+                }
+            }
+
+            // [ code:4 ]
+            // [ from_height:4 ]
+            // [[ header:80 ]...]
+            result_.resize(code_size + sizeof(uint32_t) +
+                block_header_size * count_);
+
+            for (index_ = 0; index_ < count_; ++index_)
+            {
+                yield node_.chain().fetch_block_header(
+                    size_t(from_height_) + index_, next());
+
+                if (ec_)
+                    break;
+
+                write_header();
+            }
+
+            send();
+        }
+    }
+
+    void write_header()
+    {
+        auto serial = make_unsafe_serializer(result_.begin() + code_size +
+            sizeof(uint32_t) + block_header_size * index_);
+        header_->to_data(serial, false);
+    }
+
+    // The range is truncated at the first missing header (chain top).
+    void send()
+    {
+        const auto ec = ec_ == error::not_found ? code(error::success) : ec_;
+        result_.resize(code_size + sizeof(uint32_t) +
+            block_header_size * index_);
+
+        auto serial = make_unsafe_serializer(result_.begin());
+        serial.write_error_code(ec);
+        serial.write_4_bytes_little_endian(from_height_);
+        handler_(message(request_, std::move(result_)));
+    }
+
+    server_node& node_;
+    const message request_;
+    const send_handler handler_;
+    uint32_t from_height_;
+    const uint32_t count_;
+    size_t index_;
+    const hash_list locator_;
+    size_t height_;
+    header_const_ptr header_;
+    data_chunk result_;
+    code ec_;
+};
+
+bool blockchain::unwrap_fetch_block_headers_args(uint32_t& from_height,
+    uint32_t& count, hash_list& locator, const message& request)
 {
+    // [ from_height:4 ][ count:4 ]
+    // [ count:4 ][[ locator_hash:32 ]...]
     const auto& data = request.data();
-    BITCOIN_ASSERT(data.size() == hash_size);
+    const auto by_height = data.size() == 2 * sizeof(uint32_t);
+
+    if (!by_height && (data.size() <= sizeof(uint32_t) ||
+        (data.size() - sizeof(uint32_t)) % hash_size != 0))
+        return false;
 
     auto deserial = make_safe_deserializer(data.begin(), data.end());
-    const auto block_hash = deserial.read_hash();
-    node.chain().fetch_merkle_block(block_hash,
-        std::bind(&blockchain::merkle_block_fetched,
-            _1, _2, _3, request, handler));
+    from_height = by_height ? deserial.read_4_bytes_little_endian() : 0;
+    count = deserial.read_4_bytes_little_endian();
+
+    if (count == 0 || count > max_block_headers)
+        return false;
+
+    if (!by_height)
+    {
+        const auto hashes = (data.size() - sizeof(uint32_t)) / hash_size;
+
+        if (hashes > max_locator_hashes)
+            return false;
+
+        locator.reserve(hashes);
+
+        for (size_t hash = 0; hash < hashes; ++hash)
+            locator.push_back(deserial.read_hash());
+    }
+
+    return true;
 }
 
-void blockchain::fetch_block_transaction_hashes_by_height(server_node& node,
+void blockchain::fetch_block_headers(server_node& node,
     const message& request, send_handler handler)
 {
-    const auto& data = request.data();
-    BITCOIN_ASSERT(data.size() == sizeof(uint32_t));
+    uint32_t count;
+    uint32_t from_height;
+    hash_list locator;
 
-    auto deserial = make_safe_deserializer(data.begin(), data.end());
-    const size_t block_height = deserial.read_4_bytes_little_endian();
-    node.chain().fetch_merkle_block(block_height,
-        std::bind(&blockchain::merkle_block_fetched,
-            _1, _2, _3, request, handler));
+    if (!unwrap_fetch_block_headers_args(from_height, count, locator,
+        request))
+    {
+        handler(message(request, error::bad_stream));
+        return;
+    }
+
+    block_headers_task::start(node, request, handler, from_height, count,
+        std::move(locator));
 }
 
-void blockchain::merkle_block_fetched(const code& ec, merkle_block_ptr block,
-    size_t, const message& request, send_handler handler)
+// blockchain.fetch_block_transaction_hashes
+// ----------------------------------------------------------------------------
+
+class block_transaction_hashes_task
+  : public query_task<block_transaction_hashes_task>
 {
-    // [ code:4 ]
-    // [[ hash:32 ]...]
-    data_chunk result(code_size + hash_size * block->hashes().size());
-    auto serial = make_unsafe_serializer(result.begin());
-    serial.write_error_code(ec);
+public:
+    block_transaction_hashes_task(server_node& node, const message& request,
+        send_handler handler)
+      : node_(node), request_(request), handler_(handler)
+    {
+    }
+
+private:
+    friend class query_task<block_transaction_hashes_task>;
+
+    void receive(const code& ec, merkle_block_ptr block, size_t)
+    {
+        ec_ = ec;
+        block_ = block;
+    }
+
+    void fetch()
+    {
+        const auto& data = request_.data();
+        auto deserial = make_safe_deserializer(data.begin(), data.end());
+
+        if (data.size() == hash_size)
+            node_.chain().fetch_merkle_block(deserial.read_hash(), next());
+        else
+            node_.chain().fetch_merkle_block(
+                size_t(deserial.read_4_bytes_little_endian()), next());
+    }
+
+    void resume()
+    {
+        reenter(this)
+        {
+            yield fetch();
+            send();
+        }
+    }
+
+    void send()
+    {
+        const auto hashes = ec_ ? 0 : block_->hashes().size();
+
+        // [ code:4 ]
+        // [[ hash:32 ]...]
+        data_chunk result(code_size + hash_size * hashes);
+        auto serial = make_unsafe_serializer(result.begin());
+        serial.write_error_code(ec_);
+
+        for (size_t index = 0; index < hashes; ++index)
+            serial.write_hash(block_->hashes()[index]);
+
+        handler_(message(request_, std::move(result)));
+    }
+
+    server_node& node_;
+    const message request_;
+    const send_handler handler_;
+    merkle_block_ptr block_;
+    code ec_;
+};
 
-    for (const auto& hash: block->hashes())
-        serial.write_hash(hash);
+void blockchain::fetch_block_transaction_hashes(server_node& node,
+    const message& request, send_handler handler)
+{
+    if (!is_block_key(request.data()))
+    {
+        handler(message(request, error::bad_stream));
+        return;
+    }
 
-    handler(message(request, result));
+    block_transaction_hashes_task::start(node, request, handler);
 }
 
 void blockchain::fetch_transaction_index(server_node& node,
@@ -252,14 +1107,13 @@ void blockchain::transaction_index_fetched(const code& ec,
     // [ code:4 ]
     // [ block_height:4 ]
     // [ tx_position:4 ]
-    const auto result = build_chunk(
-    {
-        message::to_bytes(ec),
-        to_little_endian(block_height32),
-        to_little_endian(tx_position32)
-    });
+    data_chunk result(code_size + 2 * sizeof(uint32_t));
+    auto serial = make_unsafe_serializer(result.begin());
+    serial.write_error_code(ec);
+    serial.write_4_bytes_little_endian(block_height32);
+    serial.write_4_bytes_little_endian(tx_position32);
 
-    handler(message(request, result));
+    handler(message(request, std::move(result)));
 }
 
 void blockchain::fetch_spend(server_node& node, const message& request,
@@ -291,13 +1145,13 @@ void blockchain::spend_fetched(const code& ec, const chain::input_point& inpoint
     // [ code:4 ]
     // [ hash:32 ]
     // [ index:4 ]
-    const auto result = build_chunk(
-    {
-        message::to_bytes(ec),
-        inpoint.to_data()
-    });
+    data_chunk result(code_size + point_size);
+    auto serial = make_unsafe_serializer(result.begin());
+    serial.write_error_code(ec);
+    serial.write_hash(inpoint.hash());
+    serial.write_4_bytes_little_endian(inpoint.index());
 
-    handler(message(request, result));
+    handler(message(request, std::move(result)));
 }
 
 void blockchain::fetch_block_height(server_node& node,
@@ -326,13 +1180,12 @@ void blockchain::block_height_fetched(const code& ec, size_t block_height,
 
     // [ code:4 ]
     // [ height:4 ]
-    const auto result = build_chunk(
-    {
-        message::to_bytes(ec),
-        to_little_endian(block_height32)
-    });
+    data_chunk result(code_size + sizeof(uint32_t));
+    auto serial = make_unsafe_serializer(result.begin());
+    serial.write_error_code(ec);
+    serial.write_4_bytes_little_endian(block_height32);
 
-    handler(message(request, result));
+    handler(message(request, std::move(result)));
 }
 
 void blockchain::fetch_stealth(server_node& node, const message& request,
@@ -389,7 +1242,7 @@ void blockchain::stealth_fetched(const code& ec,
         serial.write_hash(row.transaction_hash);
     }
 
-    handler(message(request, result));
+    handler(message(request, std::move(result)));
 }
 
 void blockchain::fetch_stealth2(server_node& node, const message& request,
@@ -440,7 +1293,7 @@ void blockchain::stealth_fetched2(const code& ec,
     for (const auto& row: stealth_results)
         serial.write_hash(row.transaction_hash);
 
-    handler(message(request, result));
+    handler(message(request, std::move(result)));
 }
 
 // Save to blockchain and announce to all connected peers.
@@ -501,3 +1354,5 @@ void blockchain::handle_validated(const code& ec, const message& request,
 
 } // namespace server
 } // namespace libbitcoin
+
+#include <boost/asio/unyield.hpp>
@@ -19,6 +19,7 @@
 #include <bitcoin/server/interface/protocol.hpp>
 
 #include <cstdint>
+#include <utility>
 #include <bitcoin/server.hpp>
 #include <bitcoin/server/configuration.hpp>
 #include <bitcoin/server/messages/message.hpp>
@@ -44,13 +45,12 @@ void protocol::total_connections(server_node& node, const message& request,
 
     // [ code:4 ]
     // [ connections:4 ]
-    const auto result = build_chunk(
-    {
-        message::to_bytes(error::success),
-        to_little_endian(static_cast<uint32_t>(count))
-    });
+    data_chunk result(code_size + sizeof(uint32_t));
+    auto serial = make_unsafe_serializer(result.begin());
+    serial.write_error_code(error::success);
+    serial.write_4_bytes_little_endian(static_cast<uint32_t>(count));
 
-    handler(message(request, result));
+    handler(message(request, std::move(result)));
 }
 
 ////// This does NOT save to our tx pool.
@@ -19,7 +19,9 @@
 #include <bitcoin/server/messages/message.hpp>
 
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <utility>
 #include <bitcoin/protocol.hpp>
 #include <bitcoin/server/messages/route.hpp>
 
@@ -41,10 +43,10 @@ using namespace bc::protocol;
 // Convert an error code to data for payload.
 data_chunk message::to_bytes(const code& ec)
 {
-    return build_chunk(
-    {
-        to_little_endian(static_cast<uint32_t>(ec.value()))
-    });
+    data_chunk data(sizeof(uint32_t));
+    auto serial = make_unsafe_serializer(data.begin());
+    serial.write_4_bytes_little_endian(static_cast<uint32_t>(ec.value()));
+    return data;
 }
 
 // Constructors.
@@ -69,6 +71,19 @@ message::message(const message& request, const data_chunk& data)
 {
 }
 
+// Construct a response for the request (moved response data with code).
+message::message(const message& request, data_chunk&& data)
+  : message(request.route(), request.command(), request.id(),
+      std::move(data))
+{
+}
+
+// Construct a response for the request (shared response data with code).
+message::message(const message& request, chunk_ptr data)
+  : message(request.route(), request.command(), request.id(), data)
+{
+}
+
 // Construct a response for the route (subscription code only).
 message::message(const server::route& route, const std::string& command,
     uint32_t id, const code& ec)
@@ -83,6 +98,21 @@ message::message(const server::route& route, const std::string& command,
 {
 }
 
+// Construct a response for the route (moved subscription data with code).
+message::message(const server::route& route, const std::string& command,
+    uint32_t id, data_chunk&& data)
+  : route_(route), command_(command), id_(id), data_(std::move(data))
+{
+}
+
+// Construct a response for the route (shared subscription data with code).
+message::message(const server::route& route, const std::string& command,
+    uint32_t id, chunk_ptr data)
+  : route_(route), command_(command), id_(id), shared_(data)
+{
+    BITCOIN_ASSERT(shared_);
+}
+
 // Properties.
 //-------------------------------------------------------------------------
 
@@ -95,7 +125,15 @@ uint32_t message::id() const
 /// Serialized query or response (defined in relation to command).
 const data_chunk& message::data() const
 {
-    return data_;
+    return shared_ ? *shared_ : data_;
+}
+
+message::chunk_ptr message::share()
+{
+    if (!shared_)
+        shared_ = std::make_shared<const data_chunk>(std::move(data_));
+
+    return shared_;
 }
 
 /// Query command (used for subscription, always returned to caller).
@@ -148,8 +186,9 @@ code message::receive(zmq::socket& socket)
     if (!message.dequeue(id_))
         return error::bad_stream;
 
-    // Serialized query.
+    // Serialized query (the frame is moved out of the message).
     data_ = message.dequeue_data();
+    shared_.reset();
 
     return error::success;
 }
@@ -174,7 +213,12 @@ code message::send(zmq::socket& socket)
     //-------------------------------------------------------------------------
     message.enqueue(command_);
     message.enqueue_little_endian(id_);
-    message.enqueue(data_);
+
+    // A shared payload is copied, otherwise the payload is moved.
+    if (shared_)
+        message.enqueue(*shared_);
+    else
+        message.enqueue(std::move(data_));
 
     return socket.send(message);
 }
@@ -0,0 +1,230 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/server/messages/message_queue.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <bitcoin/protocol.hpp>
+#include <bitcoin/server/define.hpp>
+#include <bitcoin/server/messages/message.hpp>
+
+namespace libbitcoin {
+namespace server {
+
+using namespace bc::protocol;
+
+// The queue grows as required, this is just the preallocated node count.
+static constexpr size_t initial_capacity = 1024;
+
+// The most messages held when the lock-free queue rejects a push.
+static constexpr size_t spill_capacity = 10000;
+
+message_queue::message_queue()
+  : queue_(initial_capacity),
+    signaled_(false),
+    spilling_(false),
+    spilled_(0),
+    dropped_(0)
+{
+}
+
+message_queue::~message_queue()
+{
+    message* item;
+
+    while (queue_.pop(item))
+        delete item;
+}
+
+// Signal.
+// ----------------------------------------------------------------------------
+
+// The endpoint is unique to the queue, and inproc requires a shared context.
+bool message_queue::open(zmq::authenticator& authenticator)
+{
+    const config::endpoint endpoint("inproc://message_queue_" +
+        std::to_string(reinterpret_cast<uintptr_t>(this)));
+
+    socket_ptr receiver(new zmq::socket(authenticator,
+        zmq::socket::role::pair));
+    socket_ptr sender(new zmq::socket(authenticator,
+        zmq::socket::role::pair));
+
+    auto ec = receiver->bind(endpoint);
+
+    if (!ec)
+        ec = sender->connect(endpoint);
+
+    if (ec)
+    {
+        LOG_ERROR(LOG_SERVER)
+            << "Failed to open message queue signal " << endpoint << " : "
+            << ec.message();
+        return false;
+    }
+
+    receiver_ = std::move(receiver);
+
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(sender_mutex_);
+    sender_ = std::move(sender);
+
+    // Pushes that preceded the open are dequeued without a signal.
+    signaled_ = false;
+    return true;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+void message_queue::close()
+{
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    {
+        std::lock_guard<std::mutex> lock(sender_mutex_);
+        sender_.reset();
+    }
+    ///////////////////////////////////////////////////////////////////////////
+
+    receiver_.reset();
+}
+
+zmq::socket& message_queue::signal()
+{
+    BITCOIN_ASSERT_MSG(receiver_, "message queue signal is not open");
+    return *receiver_;
+}
+
+// The flag is cleared before the queue is dequeued, so that a push which
+// follows the last pop always signals again.
+void message_queue::acknowledge()
+{
+    zmq::message packet;
+    signal().receive(packet);
+    signaled_ = false;
+}
+
+// Only the first push after an acknowledgement sends a signal, so there is
+// at most one signal in flight and the sender cannot reach high water.
+// Sockets may be used from any thread with a full fence, provided by mutex.
+void message_queue::wake()
+{
+    static const data_chunk wakeup{ 0 };
+
+    if (signaled_.exchange(true))
+        return;
+
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(sender_mutex_);
+
+    if (!sender_)
+        return;
+
+    zmq::message packet;
+    packet.enqueue(wakeup);
+    const auto ec = sender_->send(packet);
+
+    if (ec && ec != error::service_stopped)
+        LOG_WARNING(LOG_SERVER)
+            << "Failed to signal message queue: " << ec.message();
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// Queue.
+// ----------------------------------------------------------------------------
+
+// While the spill list holds messages all pushes are spilled, so that the
+// consumer (which empties the lock-free queue first) preserves their order.
+void message_queue::push(message&& item)
+{
+    std::unique_ptr<message> pointer(new message(std::move(item)));
+
+    // Ownership transfers to the queue only if the push succeeds.
+    if (!spilling_ && queue_.push(pointer.get()))
+        pointer.release();
+    else
+        spill(std::move(pointer));
+
+    wake();
+}
+
+// Every spill and drop is counted, and every drop is logged.
+void message_queue::spill(std::unique_ptr<message> item)
+{
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    std::unique_lock<std::mutex> lock(spill_mutex_);
+
+    if (spill_.size() < spill_capacity)
+    {
+        spill_.push_back(std::move(*item));
+        spilling_ = true;
+        ++spilled_;
+        return;
+    }
+
+    lock.unlock();
+    ///////////////////////////////////////////////////////////////////////////
+
+    ++dropped_;
+    LOG_WARNING(LOG_SERVER)
+        << "Dropped message " << item->command() << " to "
+        << item->route().display() << ", message queue is full.";
+}
+
+bool message_queue::pop(message& out)
+{
+    message* item;
+
+    if (queue_.pop(item))
+    {
+        const std::unique_ptr<message> pointer(item);
+        out = std::move(*pointer);
+        return true;
+    }
+
+    if (!spilling_)
+        return false;
+
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(spill_mutex_);
+
+    if (spill_.empty())
+        return false;
+
+    out = std::move(spill_.front());
+    spill_.pop_front();
+    spilling_ = !spill_.empty();
+    return true;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+message_queue::statistics message_queue::report()
+{
+    return { spilled_.exchange(0), dropped_.exchange(0) };
+}
+
+} // namespace server
+} // namespace libbitcoin
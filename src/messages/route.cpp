@@ -32,14 +32,14 @@ route::route()
 
 std::string route::display() const
 {
-    return "[" + encode_base16(address1) +
-        /*":" + encode_base16(address2) +*/ "]";
+    return "[" + encode_base16(address1) + ":" + encode_base16(address2) +
+        "]";
 }
 
 bool route::operator==(const route& other) const
 {
     return secure == other.secure && /*delimited == other.delimited &&*/
-        address1 == other.address1 /*&& address2 == other.address2*/;
+        address1 == other.address1 && address2 == other.address2;
 }
 
 } // namespace server
@@ -0,0 +1,202 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/server/messages/route_queues.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <bitcoin/protocol.hpp>
+#include <bitcoin/server/messages/message.hpp>
+#include <bitcoin/server/settings.hpp>
+
+namespace libbitcoin {
+namespace server {
+
+using namespace bc::protocol;
+
+route_queues::client::client()
+  : counters({ 0, 0, 0, 0, 0, 0 }),
+    resume(asio::time_point::min()),
+    scheduled(false)
+{
+}
+
+route_queues::route_queues(size_t depth, queue_policy policy)
+  : depth_(depth), policy_(policy)
+{
+}
+
+bool route_queues::push(message&& item)
+{
+    auto& target = clients_[item.route()];
+    auto& counters = target.counters;
+
+    if (depth_ > 0 && target.pending.size() >= depth_ && !shed(target, item))
+        return false;
+
+    // The client is scheduled for sending until its queue is emptied.
+    if (!target.scheduled)
+    {
+        target.scheduled = true;
+        ready_.push_back(&target);
+    }
+
+    target.pending.push_back(std::move(item));
+    counters.queued = target.pending.size();
+    counters.peak = std::max(counters.peak, counters.queued);
+    return true;
+}
+
+// Make room for the item in the full queue, false if disconnected instead.
+bool route_queues::shed(client& target, const message& item)
+{
+    auto& pending = target.pending;
+    auto& counters = target.counters;
+
+    switch (policy_)
+    {
+        case queue_policy::disconnect:
+        {
+            // A scheduled client remains so until the next send.
+            counters.dropped += pending.size() + 1;
+            ++counters.disconnects;
+            pending.clear();
+            counters.queued = 0;
+            return false;
+        }
+
+        case queue_policy::coalesce:
+        {
+            const auto same = [&item](const message& queued)
+            {
+                return queued.id() == item.id() &&
+                    queued.command() == item.command();
+            };
+
+            const auto it = std::find_if(pending.begin(), pending.end(), same);
+
+            if (it != pending.end())
+            {
+                pending.erase(it);
+                ++counters.dropped;
+                return true;
+            }
+
+            // There is no notification of the same subscription to replace.
+            pending.pop_front();
+            ++counters.dropped;
+            return true;
+        }
+
+        case queue_policy::drop_oldest:
+        default:
+        {
+            pending.pop_front();
+            ++counters.dropped;
+            return true;
+        }
+    }
+}
+
+void route_queues::block(const route& client, const asio::time_point& until)
+{
+    auto& target = clients_[client];
+    ++target.counters.dropped;
+    ++target.counters.blocked;
+    target.resume = std::max(target.resume, until);
+}
+
+asio::time_point route_queues::next() const
+{
+    auto earliest = asio::time_point::max();
+
+    for (const auto target: ready_)
+        earliest = std::min(earliest, target->resume);
+
+    return earliest;
+}
+
+size_t route_queues::send(zmq::socket& router, size_t burst,
+    const asio::time_point& now)
+{
+    size_t count = 0;
+    std::vector<client*> remaining;
+
+    for (const auto target: ready_)
+    {
+        auto& pending = target->pending;
+        auto& counters = target->counters;
+
+        // A held client remains scheduled with its queue intact.
+        if (target->resume > now)
+        {
+            remaining.push_back(target);
+            continue;
+        }
+
+        for (size_t sent = 0; sent < burst && !pending.empty(); ++sent)
+        {
+            auto& item = pending.front();
+            const auto ec = item.send(router);
+
+            if (ec && ec != error::service_stopped)
+                LOG_WARNING(LOG_SERVER)
+                    << "Failed to send notification to "
+                    << item.route().display() << " " << ec.message();
+
+            pending.pop_front();
+            ++counters.sent;
+            ++count;
+        }
+
+        counters.queued = pending.size();
+        target->scheduled = !pending.empty();
+
+        if (target->scheduled)
+            remaining.push_back(target);
+    }
+
+    ready_.swap(remaining);
+    return count;
+}
+
+void route_queues::report(report_handler handler)
+{
+    for (auto it = clients_.begin(); it != clients_.end();)
+    {
+        auto& counters = it->second.counters;
+
+        if (counters.sent > 0 || counters.dropped > 0 || counters.queued > 0)
+            handler(it->first, counters);
+
+        // An unscheduled client is referenced only by the map.
+        if (!it->second.scheduled)
+        {
+            it = clients_.erase(it);
+            continue;
+        }
+
+        const auto queued = counters.queued;
+        counters = { queued, queued, 0, 0, 0, 0 };
+        ++it;
+    }
+}
+
+} // namespace server
+} // namespace libbitcoin
@@ -484,10 +484,35 @@ options_metadata parser::load_settings()
         value<bool>(&configured.server.secure_only),
         "Disable public endpoints, defaults to false."
     )
+    (
+        "server.query_shards",
+        value<uint16_t>(&configured.server.query_shards),
+        "The number of query service shards per endpoint, each shard after the first binds a query shard endpoint, defaults to 1 (0 disables service)."
+    )
     (
         "server.query_workers",
         value<uint16_t>(&configured.server.query_workers),
-        "The number of query worker threads per endpoint, defaults to 1 (0 disables service)."
+        "The number of query worker threads per shard, defaults to 1 (0 disables service)."
+    )
+    (
+        "server.heavy_query_workers",
+        value<uint16_t>(&configured.server.heavy_query_workers),
+        "The number of history and stealth query worker threads per shard, defaults to 1 (0 shares query workers)."
+    )
+    (
+        "server.broadcast_query_workers",
+        value<uint16_t>(&configured.server.broadcast_query_workers),
+        "The number of broadcast and validation query worker threads per shard, defaults to 1 (0 shares query workers)."
+    )
+    (
+        "server.response_cache_size",
+        value<uint32_t>(&configured.server.response_cache_size),
+        "The maximum size in bytes of cached immutable query responses, defaults to 16777216 (0 disables)."
+    )
+    (
+        "server.query_parallelism",
+        value<uint16_t>(&configured.server.query_parallelism),
+        "The number of threads that execute a batched query, defaults to 4 (1 serial)."
     )
     (
         "server.subscription_limit",
@@ -499,6 +524,26 @@ options_metadata parser::load_settings()
         value<uint32_t>(&configured.server.subscription_expiration_minutes),
         "The subscription expiration time, defaults to 10."
     )
+    (
+        "server.notification_parallelism",
+        value<uint16_t>(&configured.server.notification_parallelism),
+        "The number of threads that match block notifications, defaults to 1 (serial)."
+    )
+    (
+        "server.notification_queue_depth",
+        value<uint32_t>(&configured.server.notification_queue_depth),
+        "The maximum number of queued notifications per client, defaults to 1000 (0 unbounded)."
+    )
+    (
+        "server.notification_queue_policy",
+        value<queue_policy>(&configured.server.notification_queue_policy),
+        "The treatment of a notification to a full client queue, 'drop_oldest', 'disconnect' or 'coalesce', defaults to 'drop_oldest'."
+    )
+    (
+        "server.subscription_snapshot_directory",
+        value<path>(&configured.server.subscription_snapshot_directory),
+        "The directory of subscriptions saved on stop and restored (and removed) on start, defaults to '' (disabled)."
+    )
     (
         "server.heartbeat_interval_seconds",
         value<uint32_t>(&configured.server.heartbeat_interval_seconds),
@@ -509,6 +554,11 @@ options_metadata parser::load_settings()
         value<bool>(&configured.server.block_service_enabled),
         "Enable the block publishing service, defaults to true."
     )
+    (
+        "server.block_reorganizations_enabled",
+        value<bool>(&configured.server.block_reorganizations_enabled),
+        "Publish reorganizations on the block service, which subscribers must distinguish from blocks, defaults to false."
+    )
     (
         "server.transaction_service_enabled",
         value<bool>(&configured.server.transaction_service_enabled),
@@ -519,6 +569,11 @@ options_metadata parser::load_settings()
         value<endpoint>(&configured.server.public_query_endpoint),
         "The public query endpoint, defaults to 'tcp://*:9091'."
     )
+    (
+        "server.public_query_shard_endpoint",
+        value<endpoint::list>(&configured.server.public_query_shard_endpoints),
+        "The public query endpoint of a shard after the first, in shard order, multiple entries allowed."
+    )
     (
         "server.public_heartbeat_endpoint",
         value<endpoint>(&configured.server.public_heartbeat_endpoint),
@@ -539,6 +594,11 @@ options_metadata parser::load_settings()
         value<endpoint>(&configured.server.secure_query_endpoint),
         "The secure query endpoint, defaults to 'tcp://*:9081'."
     )
+    (
+        "server.secure_query_shard_endpoint",
+        value<endpoint::list>(&configured.server.secure_query_shard_endpoints),
+        "The secure query endpoint of a shard after the first, in shard order, multiple entries allowed."
+    )
     (
         "server.secure_heartbeat_endpoint",
         value<endpoint>(&configured.server.secure_heartbeat_endpoint),
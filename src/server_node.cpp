@@ -18,12 +18,19 @@
  */
 #include <bitcoin/server/server_node.hpp>
 
+#include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <iterator>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 #include <bitcoin/node.hpp>
 #include <bitcoin/server/configuration.hpp>
 #include <bitcoin/server/messages/route.hpp>
+#include <bitcoin/server/utility/parallel.hpp>
+#include <bitcoin/server/utility/transaction_fields.hpp>
 #include <bitcoin/server/workers/query_worker.hpp>
 #ifdef WITH_LOCAL_MINING
 #include <boost/utility/in_place_factory.hpp>
@@ -36,12 +43,20 @@ using namespace bc::chain;
 using namespace bc::node;
 using namespace bc::protocol;
 
+// An identical query in flight for longer than this is not coalesced with.
+static const asio::duration pending_request_timeout = asio::seconds(10);
+
+// Batched history reads of one query at a time are posted to the threadpool,
+// so they occupy at most query_parallelism threads of the node.
+static constexpr size_t max_history_batches = 1;
+
 server_node::server_node(const configuration& configuration)
   : full_node(configuration),
     configuration_(configuration),
     authenticator_(*this),
-    secure_query_service_(authenticator_, *this, true),
-    public_query_service_(authenticator_, *this, false),
+    responses_(configuration.server.response_cache_size),
+    pending_requests_(pending_request_timeout),
+    history_batches_(max_history_batches),
     secure_heartbeat_service_(authenticator_, *this, true),
     public_heartbeat_service_(authenticator_, *this, false),
     secure_block_service_(authenticator_, *this, true),
@@ -67,6 +82,31 @@ const settings& server_node::server_settings() const
     return configuration_.server;
 }
 
+chain_tip& server_node::tip()
+{
+    return tip_;
+}
+
+response_cache& server_node::responses()
+{
+    return responses_;
+}
+
+request_coalescer& server_node::pending_requests()
+{
+    return pending_requests_;
+}
+
+output_cache& server_node::outputs()
+{
+    return outputs_;
+}
+
+concurrency_limit& server_node::history_batches()
+{
+    return history_batches_;
+}
+
 // Run sequence.
 // ----------------------------------------------------------------------------
 
@@ -140,14 +180,125 @@ bool server_node::close()
 
 // Subscribe (or unsubscribe) to address/stealth prefix notifications.
 void server_node::subscribe_address(const route& reply_to, uint32_t id,
-    const libbitcoin::binary& prefix_filter, bool unsubscribe)
+    const libbitcoin::binary& prefix_filter, uint8_t options,
+    bool unsubscribe)
 {
     if (reply_to.secure)
-        secure_notification_worker_
-            .subscribe_address(reply_to, id, prefix_filter, unsubscribe);
+        secure_notification_worker_.subscribe_address(reply_to, id,
+            prefix_filter, options, unsubscribe);
     else
-        public_notification_worker_
-            .subscribe_address(reply_to, id, prefix_filter, unsubscribe);
+        public_notification_worker_.subscribe_address(reply_to, id,
+            prefix_filter, options, unsubscribe);
+}
+
+// The tip and query caches are updated whether or not notifications are
+// enabled.
+// Each transaction is extracted once and relayed to both notification workers.
+// Workers that are not started (or are stopped) ignore the notification.
+// Discarded blocks are rolled back from the top before new blocks are sent.
+bool server_node::handle_reorganization(const code& ec, size_t fork_height,
+    block_const_ptr_list_const_ptr new_blocks,
+    block_const_ptr_list_const_ptr old_blocks)
+{
+    if (stopped() || ec == error::service_stopped)
+        return false;
+
+    if (ec)
+    {
+        LOG_WARNING(LOG_SERVER)
+            << "Failure handling new block: " << ec.message();
+
+        // Don't let a failure here prevent prevent future notifications.
+        return true;
+    }
+
+    // Blockchain height is 64 bit but obelisk protocol is 32 bit.
+    auto fork_height32 = safe_unsigned<uint32_t>(fork_height);
+    auto old_height = safe_add(fork_height32,
+        safe_unsigned<uint32_t>(old_blocks->size()));
+
+    // Cached responses above the fork point are no longer valid.
+    if (!old_blocks->empty())
+    {
+        responses_.invalidate(fork_height);
+        outputs_.clear();
+
+        LOG_DEBUG(LOG_SERVER)
+            << "Invalidated responses above [" << fork_height
+            << "] cache hits (" << responses_.hits() << ") misses ("
+            << responses_.misses() << ")";
+    }
+
+    // Cached outputs of addresses paid or spent by new blocks are stale.
+    for (const auto block: *new_blocks)
+        outputs_.invalidate(*block);
+
+    // The last new block is the top of the chain.
+    if (!new_blocks->empty())
+        tip_.set(fork_height + new_blocks->size(),
+            new_blocks->back()->header());
+
+    if (configuration_.server.subscription_limit == 0)
+        return true;
+
+    for (auto it = old_blocks->rbegin(); it != old_blocks->rend(); ++it)
+    {
+        const auto height = old_height--;
+        const auto block_hash = (*it)->header().hash();
+        const auto txs = extract(*it);
+        secure_notification_worker_.notify_rollback(height, block_hash, txs);
+        public_notification_worker_.notify_rollback(height, block_hash, txs);
+    }
+
+    for (const auto block: *new_blocks)
+    {
+        const auto height = safe_increment(fork_height32);
+        const auto block_hash = block->header().hash();
+        const auto txs = extract(block);
+        secure_notification_worker_.notify_block(height, block_hash, txs);
+        public_notification_worker_.notify_block(height, block_hash, txs);
+    }
+
+    return true;
+}
+
+bool server_node::handle_transaction_pool(const code& ec,
+    transaction_const_ptr tx)
+{
+    if (stopped() || ec == error::service_stopped)
+        return false;
+
+    if (ec)
+    {
+        LOG_WARNING(LOG_SERVER)
+            << "Failure handling new transaction: " << ec.message();
+
+        // Don't let a failure here prevent future notifications.
+        return true;
+    }
+
+    const transaction_fields fields(*tx);
+    secure_notification_worker_.notify_transaction(0, null_hash, fields);
+    public_notification_worker_.notify_transaction(0, null_hash, fields);
+    return true;
+}
+
+// Transactions are referenced in place, the block pointer retains them.
+transaction_fields::list server_node::extract(block_const_ptr block)
+{
+    const auto& txs = block->transactions();
+    transaction_fields::list fields(txs.size());
+    const auto parallelism = configuration_.server.notification_parallelism;
+
+    const auto extractor = [&txs, &fields](size_t first, size_t last)
+    {
+        for (auto index = first; index < last; ++index)
+            fields[index] = std::make_shared<const transaction_fields>(
+                txs[index]);
+    };
+
+    parallel_for(thread_pool(), txs.size(), parallelism, extractor);
+    return fields;
 }
 
 ////// Subscribe to transaction penetration notifications.
@@ -168,11 +319,96 @@ void server_node::subscribe_address(const route& reply_to, uint32_t id,
 bool server_node::start_services()
 {
     return
-        start_authenticator() && start_query_services() &&
+        check_endpoints() &&
+        start_authenticator() && start_chain_tracking() &&
+        start_query_services() &&
         start_heartbeat_services() && start_block_services() &&
         start_transaction_services();
 }
 
+// Endpoints collide if equal, or on the same port of the same or any host.
+static bool collides(const config::endpoint& left,
+    const config::endpoint& right)
+{
+    if (left.to_string() == right.to_string())
+        return true;
+
+    return left.port() != 0 && left.port() == right.port() &&
+        (left.host() == right.host() || left.host() == "*" ||
+            right.host() == "*");
+}
+
+// Each shard must have an endpoint, and no two enabled services may bind
+// colliding endpoints. This is checked before any service is bound.
+bool server_node::check_endpoints() const
+{
+    typedef std::pair<std::string, config::endpoint> named_endpoint;
+
+    const auto& settings = configuration_.server;
+    const auto queries = settings.query_workers > 0 &&
+        settings.query_shards > 0;
+    std::vector<named_endpoint> endpoints;
+
+    for (const auto secure: { true, false })
+    {
+        const std::string security(secure ? "secure" : "public");
+
+        if ((secure && !settings.server_private_key) ||
+            (!secure && settings.secure_only))
+            continue;
+
+        for (uint16_t shard = 0; queries && shard < settings.query_shards;
+            ++shard)
+        {
+            config::endpoint endpoint;
+
+            if (!query_service::client_endpoint(endpoint, settings, secure,
+                shard))
+            {
+                LOG_ERROR(LOG_SERVER)
+                    << "Query shard " << shard << " requires a "
+                    << security << " query shard endpoint.";
+                return false;
+            }
+
+            endpoints.emplace_back(security + " query shard " +
+                std::to_string(shard), endpoint);
+        }
+
+        if (settings.heartbeat_interval_seconds > 0)
+            endpoints.emplace_back(security + " heartbeat", secure ?
+                settings.secure_heartbeat_endpoint :
+                settings.public_heartbeat_endpoint);
+
+        if (settings.block_service_enabled)
+            endpoints.emplace_back(security + " block", secure ?
+                settings.secure_block_endpoint :
+                settings.public_block_endpoint);
+
+        if (settings.transaction_service_enabled)
+            endpoints.emplace_back(security + " transaction", secure ?
+                settings.secure_transaction_endpoint :
+                settings.public_transaction_endpoint);
+    }
+
+    for (auto left = endpoints.begin(); left != endpoints.end(); ++left)
+    {
+        for (auto right = std::next(left); right != endpoints.end(); ++right)
+        {
+            if (collides(left->second, right->second))
+            {
+                LOG_ERROR(LOG_SERVER)
+                    << "The " << left->first << " endpoint "
+                    << left->second << " collides with the " << right->first
+                    << " endpoint " << right->second;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
 bool server_node::start_authenticator()
 {
     const auto& settings = configuration_.server;
@@ -188,26 +424,49 @@ bool server_node::start_authenticator()
     return authenticator_.start();
 }
 
+// The subscription precedes the read of the tip so that no block is missed.
+// A failed read does not prevent startup, the tip is then read by the first
+// tip query or set by the next reorganization.
+bool server_node::start_chain_tracking()
+{
+    size_t height;
+    chain::header header;
+
+    // Subscribe to blockchain reorganizations.
+    subscribe_blockchain(
+        std::bind(&server_node::handle_reorganization,
+            this, _1, _2, _3, _4));
+
+    if (chain_.get_last_height(height) && chain_.get_header(header, height))
+        tip_.initialize(height, header);
+    else
+        LOG_WARNING(LOG_SERVER)
+            << "Failed to read the top block of the chain, deferred.";
+
+    return true;
+}
+
 bool server_node::start_query_services()
 {
     const auto& settings = configuration_.server;
 
     // Subscriptions require the query service.
-    if (settings.query_workers == 0)
+    if (settings.query_workers == 0 || settings.query_shards == 0)
         return true;
 
-    // Start secure service, query workers and notification workers if enabled.
-    if (settings.server_private_key && (!secure_query_service_.start() ||
-        (settings.subscription_limit > 0 && !secure_notification_worker_.start()) ||
-        !start_query_workers(true)))
+    // Start secure shards, query workers and notification workers if enabled.
+    if (settings.server_private_key && (!start_query_shards(true) ||
+        (settings.subscription_limit > 0 && !secure_notification_worker_.start())))
             return false;
 
-    // Start public service, query workers and notification workers if enabled.
-    if (!settings.secure_only && (!public_query_service_.start() ||
-        (settings.subscription_limit > 0 && !public_notification_worker_.start()) ||
-        !start_query_workers(false)))
+    // Start public shards, query workers and notification workers if enabled.
+    if (!settings.secure_only && (!start_query_shards(false) ||
+        (settings.subscription_limit > 0 && !public_notification_worker_.start())))
             return false;
 
+    if (settings.subscription_limit > 0)
+        start_notification_relay();
+
     return true;
 }
 
@@ -266,15 +525,49 @@ bool server_node::start_transaction_services()
 }
 
 // Called from start_query_services.
-bool server_node::start_query_workers(bool secure)
+// Each shard is a query service (broker) with its own workers.
+bool server_node::start_query_shards(bool secure)
 {
     auto& server = *this;
     const auto& settings = configuration_.server;
 
-    for (auto count = 0; count < settings.query_workers; ++count)
+    for (uint16_t shard = 0; shard < settings.query_shards; ++shard)
+    {
+        auto service = std::make_shared<query_service>(authenticator_,
+            server, secure, shard);
+
+        if (!service->start() || !start_query_workers(secure, shard))
+            return false;
+
+        subscribe_stop([=](const code&) { service->stop(); });
+    }
+
+    return true;
+}
+
+// Lanes without workers are dispatched to the cheap lane by the service.
+bool server_node::start_query_workers(bool secure, uint16_t shard)
+{
+    const auto& settings = configuration_.server;
+
+    return
+        start_query_workers(secure, shard, query_service::lane::cheap,
+            settings.query_workers) &&
+        start_query_workers(secure, shard, query_service::lane::heavy,
+            settings.heavy_query_workers) &&
+        start_query_workers(secure, shard, query_service::lane::broadcast,
+            settings.broadcast_query_workers);
+}
+
+bool server_node::start_query_workers(bool secure, uint16_t shard,
+    query_service::lane lane, uint16_t count)
+{
+    auto& server = *this;
+
+    for (auto index = 0; index < count; ++index)
     {
         auto worker = std::make_shared<query_worker>(authenticator_,
-            server, secure);
+            server, secure, lane, shard);
 
         if (!worker->start())
             return false;
@@ -285,6 +578,16 @@ bool server_node::start_query_workers(bool secure)
     return true;
 }
 
+// Called from start_query_services.
+// Blockchain reorganizations are subscribed by chain tracking.
+void server_node::start_notification_relay()
+{
+    // Subscribe to transaction pool acceptances.
+    subscribe_transaction(
+        std::bind(&server_node::handle_transaction_pool,
+            this, _1, _2));
+}
+
 // static
 uint32_t server_node::threads_required(const configuration& configuration)
 {
@@ -297,11 +600,10 @@ uint32_t server_node::threads_required(const configuration& configuration)
     {
         if (settings.server_private_key)
         {
-            // Secure query service.
-            ++required;
-
-            // Secure query worker.
-            required += settings.query_workers;
+            // Secure query service and query workers (of each lane) per shard.
+            required += settings.query_shards * (1 + settings.query_workers +
+                settings.heavy_query_workers +
+                settings.broadcast_query_workers);
 
             // Secure notification worker.
             required += (settings.subscription_limit > 0 ? 1 : 0);
@@ -309,11 +611,10 @@ uint32_t server_node::threads_required(const configuration& configuration)
 
         if (!settings.secure_only)
         {
-            // Public query service.
-            ++required;
-
-            // Public query worker.
-            required += settings.query_workers;
+            // Public query service and query workers (of each lane) per shard.
+            required += settings.query_shards * (1 + settings.query_workers +
+                settings.heavy_query_workers +
+                settings.broadcast_query_workers);
 
             // Public notification worker.
             required += (settings.subscription_limit > 0 ? 1 : 0);
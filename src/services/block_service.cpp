@@ -146,7 +146,8 @@ bool block_service::unbind(zmq::socket& xpub, zmq::socket& xsub)
 // ----------------------------------------------------------------------------
 
 bool block_service::handle_reorganization(const code& ec, size_t fork_height,
-    block_const_ptr_list_const_ptr new_blocks, block_const_ptr_list_const_ptr)
+    block_const_ptr_list_const_ptr new_blocks,
+    block_const_ptr_list_const_ptr old_blocks)
 {
     if (stopped() || ec == error::service_stopped)
         return false;
@@ -161,12 +162,16 @@ bool block_service::handle_reorganization(const code& ec, size_t fork_height,
     }
 
     // Blockchain height is 64 bit but obelisk protocol is 32 bit.
-    publish_blocks(safe_unsigned<uint32_t>(fork_height), new_blocks);
+    publish_blocks(safe_unsigned<uint32_t>(fork_height), new_blocks,
+        old_blocks);
     return true;
 }
 
+// Any reorganization (if enabled) is published before the blocks that replace
+// it.
 void block_service::publish_blocks(uint32_t fork_height,
-    block_const_ptr_list_const_ptr blocks)
+    block_const_ptr_list_const_ptr new_blocks,
+    block_const_ptr_list_const_ptr old_blocks)
 {
     if (stopped())
         return;
@@ -192,14 +197,63 @@ void block_service::publish_blocks(uint32_t fork_height,
         return;
     }
 
-    BITCOIN_ASSERT(blocks->size() <= max_uint32);
-    BITCOIN_ASSERT(fork_height < max_uint32 - blocks->size());
+    // Existing subscribers parse every publication as a block, so a
+    // reorganization is published only if configured.
+    if (settings_.block_reorganizations_enabled && !old_blocks->empty())
+        publish_reorganization(publisher, fork_height, *old_blocks);
+
+    BITCOIN_ASSERT(new_blocks->size() <= max_uint32);
+    BITCOIN_ASSERT(fork_height < max_uint32 - new_blocks->size());
     auto height = fork_height;
 
-    for (const auto block: *blocks)
+    for (const auto block: *new_blocks)
         publish_block(publisher, height++, block);
 }
 
+// [ fork_height:4 ]
+// [ count:4 ]
+// [ block_hash:32 ]...
+// The hashes of the discarded blocks are ordered by height above the fork.
+// The third frame distinguishes this from a block publication.
+void block_service::publish_reorganization(zmq::socket& publisher,
+    uint32_t fork_height, const block_const_ptr_list& old_blocks)
+{
+    if (stopped())
+        return;
+
+    const auto security = secure_ ? "secure" : "public";
+    BITCOIN_ASSERT(old_blocks.size() <= max_uint32);
+    const auto count = static_cast<uint32_t>(old_blocks.size());
+
+    data_chunk hashes(count * hash_size);
+    auto serial = make_unsafe_serializer(hashes.begin());
+
+    for (const auto block: old_blocks)
+        serial.write_hash(block->header().hash());
+
+    zmq::message broadcast;
+    broadcast.enqueue_little_endian(fork_height);
+    broadcast.enqueue_little_endian(count);
+    broadcast.enqueue(hashes);
+    const auto ec = publisher.send(broadcast);
+
+    if (ec == error::service_stopped)
+        return;
+
+    if (ec)
+    {
+        LOG_WARNING(LOG_SERVER)
+            << "Failed to publish " << security << " reorganization at ["
+            << fork_height << "] " << ec.message();
+        return;
+    }
+
+    if (verbose_)
+        LOG_DEBUG(LOG_SERVER)
+            << "Published " << security << " reorganization at ["
+            << fork_height << "] of (" << count << ") blocks";
+}
+
 // [ height:4 ]
 // [ header:80 ]
 // [ txs... ]
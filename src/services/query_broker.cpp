@@ -0,0 +1,212 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/server/services/query_broker.hpp>
+
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <zmq.h>
+#include <bitcoin/protocol.hpp>
+#include <bitcoin/server/define.hpp>
+#include <bitcoin/server/services/query_service.hpp>
+
+namespace libbitcoin {
+namespace server {
+
+using namespace bc::protocol;
+
+query_broker::query_broker(zmq::socket& router, zmq::socket& query_dealer,
+    zmq::socket& heavy_dealer, zmq::socket& broadcast_dealer,
+    zmq::socket& notify_dealer, bool heavy, bool broadcast)
+  : router_(router),
+    query_dealer_(query_dealer),
+    heavy_dealer_(heavy_dealer),
+    broadcast_dealer_(broadcast_dealer),
+    notify_dealer_(notify_dealer),
+    heavy_(heavy),
+    broadcast_(broadcast),
+    dropped_(0)
+{
+}
+
+// The dealers block until there are available workers.
+// The router fails messages for lost peers (clients) and high water, which
+// are dropped (see respond), other than notifications at high water (see
+// notify).
+void query_broker::run(stopped_handler stopped)
+{
+    zmq::poller poller;
+    poller.add(router_);
+    poller.add(query_dealer_);
+    poller.add(heavy_dealer_);
+    poller.add(broadcast_dealer_);
+    poller.add(notify_dealer_);
+
+    while (!poller.terminated() && !stopped())
+    {
+        const auto signaled = poller.wait();
+
+        if (signaled.contains(router_.id()) && !dispatch())
+        {
+            LOG_WARNING(LOG_SERVER)
+                << "Failed to dispatch from router to query dealers.";
+        }
+
+        if (signaled.contains(query_dealer_.id()) && !respond(query_dealer_))
+        {
+            LOG_WARNING(LOG_SERVER)
+                << "Failed to forward from query_dealer to router.";
+        }
+
+        if (signaled.contains(heavy_dealer_.id()) && !respond(heavy_dealer_))
+        {
+            LOG_WARNING(LOG_SERVER)
+                << "Failed to forward from heavy_dealer to router.";
+        }
+
+        if (signaled.contains(broadcast_dealer_.id()) &&
+            !respond(broadcast_dealer_))
+        {
+            LOG_WARNING(LOG_SERVER)
+                << "Failed to forward from broadcast_dealer to router.";
+        }
+
+        if (signaled.contains(notify_dealer_.id()) && !notify())
+        {
+            LOG_WARNING(LOG_SERVER)
+                << "Failed to forward from notify_dealer to router.";
+        }
+    }
+}
+
+query_service::lane query_broker::to_lane(const std::string& command) const
+{
+    const auto classified = query_service::classify(command);
+
+    if ((classified == query_service::lane::heavy && !heavy_) ||
+        (classified == query_service::lane::broadcast && !broadcast_))
+        return query_service::lane::cheap;
+
+    return classified;
+}
+
+// Frames are [address][delimiter?][command][id][data], the router having
+// prepended the client address. Malformed queries are dispatched as cheap,
+// the worker drops them. Frames are moved, not copied, to read the command.
+bool query_broker::dispatch()
+{
+    zmq::message packet;
+
+    if (router_.receive(packet))
+        return false;
+
+    data_stack frames;
+
+    while (packet.size() > 0)
+        frames.push_back(packet.dequeue_data());
+
+    const size_t command_index = frames.size() == 5 ? 2 : 1;
+    const auto command = frames.size() > command_index ?
+        std::string(frames[command_index].begin(),
+            frames[command_index].end()) : std::string();
+
+    for (auto& frame: frames)
+        packet.enqueue(std::move(frame));
+
+    switch (to_lane(command))
+    {
+        case query_service::lane::heavy:
+            return !heavy_dealer_.send(packet);
+        case query_service::lane::broadcast:
+            return !broadcast_dealer_.send(packet);
+        case query_service::lane::cheap:
+        default:
+            return !query_dealer_.send(packet);
+    }
+}
+
+// Frames are [client][delimiter?][command][id][data], the query worker having
+// returned the route. A response to a lost client or a client at high water is
+// dropped and counted, as the router dropped it before it was made mandatory.
+bool query_broker::respond(zmq::socket& dealer)
+{
+    zmq::message packet;
+
+    if (dealer.receive(packet))
+        return false;
+
+    if (!router_.send(packet))
+        return true;
+
+    const auto error = zmq_errno();
+
+    if (error != EHOSTUNREACH && error != EAGAIN)
+        return false;
+
+    ++dropped_;
+    return true;
+}
+
+// Frames are [client][delimiter?][command][id][data], the notification worker
+// having addressed this shard. A notification rejected at client high water
+// is dropped and [client] is returned to the notification worker (via its
+// router, which prepends this shard), so that it holds the client's queue.
+bool query_broker::notify()
+{
+    zmq::message packet;
+
+    if (notify_dealer_.receive(packet))
+        return false;
+
+    data_stack frames;
+
+    while (packet.size() > 0)
+        frames.push_back(packet.dequeue_data());
+
+    if (frames.empty())
+        return false;
+
+    const auto client = frames.front();
+
+    for (auto& frame: frames)
+        packet.enqueue(std::move(frame));
+
+    if (!router_.send(packet))
+        return true;
+
+    // The client is lost, the notification is dropped.
+    if (zmq_errno() != EAGAIN)
+    {
+        ++dropped_;
+        return true;
+    }
+
+    zmq::message blocked;
+    blocked.enqueue(client);
+    return !notify_dealer_.send(blocked);
+}
+
+size_t query_broker::dropped() const
+{
+    return dropped_;
+}
+
+} // namespace server
+} // namespace libbitcoin
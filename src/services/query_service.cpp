@@ -18,8 +18,14 @@
  */
 #include <bitcoin/server/services/query_service.hpp>
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <zmq.h>
 #include <bitcoin/protocol.hpp>
 #include <bitcoin/server/server_node.hpp>
+#include <bitcoin/server/services/query_broker.hpp>
 #include <bitcoin/server/settings.hpp>
 
 namespace libbitcoin {
@@ -31,81 +37,229 @@ using namespace bc::protocol;
 static const auto domain = "query";
 const config::endpoint query_service::public_query("inproc://public_query");
 const config::endpoint query_service::secure_query("inproc://secure_query");
+const config::endpoint query_service::public_heavy_query(
+    "inproc://public_heavy_query");
+const config::endpoint query_service::secure_heavy_query(
+    "inproc://secure_heavy_query");
+const config::endpoint query_service::public_broadcast_query(
+    "inproc://public_broadcast_query");
+const config::endpoint query_service::secure_broadcast_query(
+    "inproc://secure_broadcast_query");
 const config::endpoint query_service::public_notify("inproc://public_notify");
 const config::endpoint query_service::secure_notify("inproc://secure_notify");
 
+// These read (and merge) address histories of unbounded size.
+static const std::unordered_set<std::string> heavy_commands
+{
+    "blockchain.fetch_balance",
+    "blockchain.fetch_block_headers",
+    "blockchain.fetch_history2",
+    "blockchain.fetch_history3",
+    "blockchain.fetch_history4",
+    "blockchain.fetch_stealth",
+    "blockchain.fetch_stealth2",
+    "blockchain.fetch_unspent_outputs"
+};
+
+// These validate transactions or blocks against the chain.
+static const std::unordered_set<std::string> broadcast_commands
+{
+    "blockchain.broadcast",
+    "blockchain.validate",
+    "transaction_pool.broadcast",
+    "transaction_pool.validate2"
+};
+
 query_service::query_service(zmq::authenticator& authenticator,
-    server_node& node, bool secure)
+    server_node& node, bool secure, uint16_t shard)
   : worker(node.thread_pool()),
     secure_(secure),
+    shard_(shard),
     settings_(node.server_settings()),
     authenticator_(authenticator)
 {
 }
 
-// Implement worker as a broker.
-// The dealer blocks until there are available workers.
-// The router drops messages for lost peers (clients) and high water.
+// Lanes.
+//-----------------------------------------------------------------------------
+
+// static
+query_service::lane query_service::classify(const std::string& command)
+{
+    if (heavy_commands.find(command) != heavy_commands.end())
+        return lane::heavy;
+
+    if (broadcast_commands.find(command) != broadcast_commands.end())
+        return lane::broadcast;
+
+    return lane::cheap;
+}
+
+// Shards.
+//-----------------------------------------------------------------------------
+
+// Shard zero retains the unsuffixed inprocess endpoints.
+static config::endpoint to_shard(const config::endpoint& endpoint,
+    uint16_t shard)
+{
+    if (shard == 0)
+        return endpoint;
+
+    return config::endpoint(endpoint.to_string() + "_" +
+        std::to_string(shard));
+}
+
+// static
+config::endpoint query_service::worker_endpoint(lane lane, bool secure,
+    uint16_t shard)
+{
+    switch (lane)
+    {
+        case lane::heavy:
+            return to_shard(secure ? secure_heavy_query : public_heavy_query,
+                shard);
+        case lane::broadcast:
+            return to_shard(secure ? secure_broadcast_query :
+                public_broadcast_query, shard);
+        case lane::cheap:
+        default:
+            return to_shard(secure ? secure_query : public_query, shard);
+    }
+}
+
+// static
+config::endpoint query_service::notify_endpoint(bool secure, uint16_t shard)
+{
+    return to_shard(secure ? secure_notify : public_notify, shard);
+}
+
+// Clients are distributed across shards by connecting to the shard endpoints.
+// Shards after the first bind the shard endpoints, in order of configuration.
+// static
+bool query_service::client_endpoint(config::endpoint& out,
+    const settings& settings, bool secure, uint16_t shard)
+{
+    const auto& shards = secure ? settings.secure_query_shard_endpoints :
+        settings.public_query_shard_endpoints;
+
+    if (shard == 0)
+    {
+        out = secure ? settings.secure_query_endpoint :
+            settings.public_query_endpoint;
+        return true;
+    }
+
+    if (shard > shards.size())
+        return false;
+
+    out = shards[shard - 1];
+    return true;
+}
+
+// The dealers of a shard share a routing identity. A query worker records it
+// as the first address of the query route, and the notification worker, with
+// a router connected to the notify dealer of each shard, sends a notification
+// to that route through the notify dealer of the originating shard.
+static bool set_identity(zmq::socket& dealer, uint16_t shard)
+{
+    const auto identity = "shard_" + std::to_string(shard);
+    return zmq_setsockopt(dealer.self(), ZMQ_IDENTITY, identity.data(),
+        identity.size()) == 0;
+}
+
+// The client router fails (rather than drops or blocks) a message to a client
+// at high water, so that the notification worker may shed for the client.
+static bool set_mandatory(zmq::socket& router)
+{
+    static constexpr int enabled = 1;
+    static constexpr int immediate = 0;
+
+    return
+        zmq_setsockopt(router.self(), ZMQ_ROUTER_MANDATORY, &enabled,
+            sizeof(enabled)) == 0 &&
+        zmq_setsockopt(router.self(), ZMQ_SNDTIMEO, &immediate,
+            sizeof(immediate)) == 0;
+}
+
+// Implement worker as a broker (see query_broker).
 void query_service::work()
 {
     zmq::socket router(authenticator_, zmq::socket::role::router);
     zmq::socket query_dealer(authenticator_, zmq::socket::role::dealer);
+    zmq::socket heavy_dealer(authenticator_, zmq::socket::role::dealer);
+    zmq::socket broadcast_dealer(authenticator_, zmq::socket::role::dealer);
     zmq::socket notify_dealer(authenticator_, zmq::socket::role::dealer);
 
     // Bind sockets to the service and worker endpoints.
-    if (!started(bind(router, query_dealer, notify_dealer)))
+    if (!started(bind(router, query_dealer, heavy_dealer, broadcast_dealer,
+        notify_dealer)))
         return;
 
-    zmq::poller poller;
-    poller.add(router);
-    poller.add(query_dealer);
-    poller.add(notify_dealer);
+    query_broker broker(router, query_dealer, heavy_dealer, broadcast_dealer,
+        notify_dealer, settings_.heavy_query_workers > 0,
+        settings_.broadcast_query_workers > 0);
 
-    while (!poller.terminated() && !stopped())
+    broker.run([this]()
     {
-        const auto signaled = poller.wait();
-
-        if (signaled.contains(router.id()) &&
-            !forward(router, query_dealer))
-        {
-            LOG_WARNING(LOG_SERVER)
-                << "Failed to forward from router to query_dealer.";
-        }
-
-        if (signaled.contains(query_dealer.id()) &&
-            !forward(query_dealer, router))
-        {
-            LOG_WARNING(LOG_SERVER)
-                << "Failed to forward from query_dealer to router.";
-        }
-
-        if (signaled.contains(notify_dealer.id()) &&
-            !forward(notify_dealer, router))
-        {
-            LOG_WARNING(LOG_SERVER)
-                << "Failed to forward from notify_dealer to router.";
-        }
-    }
+        return stopped();
+    });
+
+    LOG_DEBUG(LOG_SERVER)
+        << "Dropped " << broker.dropped() << " "
+        << (secure_ ? "secure" : "public") << " query shard " << shard_
+        << " messages to lost or blocked clients.";
 
     // Unbind the sockets and exit this thread.
-    finished(unbind(router, query_dealer, notify_dealer));
+    finished(unbind(router, query_dealer, heavy_dealer, broadcast_dealer,
+        notify_dealer));
 }
 
 // Bind/Unbind.
 //-----------------------------------------------------------------------------
 
+// Lane dealers are bound whether or not the lane has workers.
 bool query_service::bind(zmq::socket& router, zmq::socket& query_dealer,
+    zmq::socket& heavy_dealer, zmq::socket& broadcast_dealer,
     zmq::socket& notify_dealer)
 {
     const auto security = secure_ ? "secure" : "public";
-    const auto& query_worker = secure_ ? secure_query : public_query;
-    const auto& notify_worker = secure_ ? secure_notify : public_notify;
-    const auto& query_service = secure_ ? settings_.secure_query_endpoint :
-        settings_.public_query_endpoint;
+    const auto query_worker = worker_endpoint(lane::cheap, secure_, shard_);
+    const auto heavy_worker = worker_endpoint(lane::heavy, secure_, shard_);
+    const auto broadcast_worker = worker_endpoint(lane::broadcast, secure_,
+        shard_);
+    const auto notify_worker = notify_endpoint(secure_, shard_);
+    config::endpoint query_service;
+
+    if (!client_endpoint(query_service, settings_, secure_, shard_))
+    {
+        LOG_ERROR(LOG_SERVER)
+            << "No " << security << " query endpoint configured for shard "
+            << shard_;
+        return false;
+    }
 
     if (!authenticator_.apply(router, domain, secure_))
         return false;
 
+    if (!set_mandatory(router))
+    {
+        LOG_ERROR(LOG_SERVER)
+            << "Failed to set " << security
+            << " query service router options.";
+        return false;
+    }
+
+    if (!set_identity(query_dealer, shard_) ||
+        !set_identity(heavy_dealer, shard_) ||
+        !set_identity(broadcast_dealer, shard_) ||
+        !set_identity(notify_dealer, shard_))
+    {
+        LOG_ERROR(LOG_SERVER)
+            << "Failed to set " << security << " query shard " << shard_
+            << " dealer identity.";
+        return false;
+    }
+
     auto ec = router.bind(query_service);
 
     if (ec)
@@ -126,6 +280,26 @@ bool query_service::bind(zmq::socket& router, zmq::socket& query_dealer,
         return false;
     }
 
+    ec = heavy_dealer.bind(heavy_worker);
+
+    if (ec)
+    {
+        LOG_ERROR(LOG_SERVER)
+            << "Failed to bind " << security << " heavy query workers to "
+            << heavy_worker << " : " << ec.message();
+        return false;
+    }
+
+    ec = broadcast_dealer.bind(broadcast_worker);
+
+    if (ec)
+    {
+        LOG_ERROR(LOG_SERVER)
+            << "Failed to bind " << security << " broadcast query workers to "
+            << broadcast_worker << " : " << ec.message();
+        return false;
+    }
+
     ec = notify_dealer.bind(notify_worker);
 
     if (ec)
@@ -142,11 +316,14 @@ bool query_service::bind(zmq::socket& router, zmq::socket& query_dealer,
 }
 
 bool query_service::unbind(zmq::socket& router, zmq::socket& query_dealer,
+    zmq::socket& heavy_dealer, zmq::socket& broadcast_dealer,
     zmq::socket& notify_dealer)
 {
     // Stop all even if one fails.
     const auto service_stop = router.stop();
     const auto query_stop = query_dealer.stop();
+    const auto heavy_stop = heavy_dealer.stop();
+    const auto broadcast_stop = broadcast_dealer.stop();
     const auto notify_stop = notify_dealer.stop();
     const auto security = secure_ ? "secure" : "public";
 
@@ -158,12 +335,21 @@ bool query_service::unbind(zmq::socket& router, zmq::socket& query_dealer,
         LOG_ERROR(LOG_SERVER)
             << "Failed to unbind " << security << " query workers.";
 
+    if (!heavy_stop)
+        LOG_ERROR(LOG_SERVER)
+            << "Failed to unbind " << security << " heavy query workers.";
+
+    if (!broadcast_stop)
+        LOG_ERROR(LOG_SERVER)
+            << "Failed to unbind " << security << " broadcast query workers.";
+
     if (!notify_stop)
         LOG_ERROR(LOG_SERVER)
             << "Failed to unbind " << security << " notify workers.";
 
     // Don't log stop success.
-    return service_stop && query_stop && notify_stop;
+    return service_stop && query_stop && heavy_stop && broadcast_stop &&
+        notify_stop;
 }
 
 } // namespace server
@@ -18,20 +18,37 @@
  */
 #include <bitcoin/server/settings.hpp>
 
+#include <iostream>
+#include <string>
+#include <boost/program_options.hpp>
 #include <bitcoin/node.hpp>
 
 namespace libbitcoin {
 namespace server {
 
 using namespace asio;
+using namespace boost::program_options;
+
+static const std::string policy_drop_oldest("drop_oldest");
+static const std::string policy_disconnect("disconnect");
+static const std::string policy_coalesce("coalesce");
 
 settings::settings()
-  : query_workers(1),
+  : query_shards(1),
+    query_workers(1),
+    heavy_query_workers(1),
+    broadcast_query_workers(1),
+    response_cache_size(16777216),
+    query_parallelism(4),
     heartbeat_interval_seconds(5),
     subscription_expiration_minutes(10),
     subscription_limit(0 /*100000000*/),
+    notification_parallelism(1),
+    notification_queue_depth(1000),
+    notification_queue_policy(queue_policy::drop_oldest),
     secure_only(false),
     block_service_enabled(true),
+    block_reorganizations_enabled(false),
     transaction_service_enabled(true),
     public_query_endpoint("tcp://*:9091"),
     public_heartbeat_endpoint("tcp://*:9092"),
@@ -60,5 +77,46 @@ duration settings::subscription_expiration() const
     return minutes(subscription_expiration_minutes);
 }
 
+// Queue policy.
+// ----------------------------------------------------------------------------
+
+std::istream& operator>>(std::istream& input, queue_policy& argument)
+{
+    std::string text;
+    input >> text;
+
+    if (text == policy_drop_oldest)
+        argument = queue_policy::drop_oldest;
+    else if (text == policy_disconnect)
+        argument = queue_policy::disconnect;
+    else if (text == policy_coalesce)
+        argument = queue_policy::coalesce;
+    else
+    {
+        BOOST_THROW_EXCEPTION(invalid_option_value(text));
+    }
+
+    return input;
+}
+
+std::ostream& operator<<(std::ostream& output, const queue_policy& argument)
+{
+    switch (argument)
+    {
+        case queue_policy::disconnect:
+            output << policy_disconnect;
+            break;
+        case queue_policy::coalesce:
+            output << policy_coalesce;
+            break;
+        case queue_policy::drop_oldest:
+        default:
+            output << policy_drop_oldest;
+            break;
+    }
+
+    return output;
+}
+
 } // namespace server
 } // namespace libbitcoin
@@ -0,0 +1,687 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/server/utility/address_index.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <bitcoin/bitcoin.hpp>
+#include <bitcoin/server/messages/route.hpp>
+
+namespace libbitcoin {
+namespace server {
+
+// Subscription deadlines are spread over this many slots of each wheel.
+// The inner wheel spans the horizon by tick, the outer wheel spans this many
+// inner revolutions, each of its slots cascading into the inner wheel.
+static constexpr uint64_t wheel_slots = 1024;
+
+// Compact subscribers abbreviate confirmation of this many pool transactions.
+static constexpr size_t delivered_limit = 1024;
+
+// The snapshot format version, incremented on any change to the format.
+static constexpr uint8_t snapshot_version = 2;
+
+// A zeromq identity is at most this many bytes.
+static constexpr size_t maximum_address_size = 255;
+
+// A prefix filter is at most the bits of an address hash.
+static constexpr size_t maximum_prefix_bits = short_hash_size * byte_bits;
+
+// Expiration is not tracked more finely than this.
+static const asio::duration minimum_resolution = asio::seconds(1);
+
+// The number of leading bits shared by the two prefixes.
+static size_t common_bits(const binary& left, const binary& right)
+{
+    const auto length = std::min(left.size(), right.size());
+    size_t bit = 0;
+
+    while (bit < length && left[bit] == right[bit])
+        ++bit;
+
+    return bit;
+}
+
+// The child slot selected by the bit following the parent prefix.
+static size_t branch(const binary& key, size_t position)
+{
+    return key[position] ? 1 : 0;
+}
+
+address_index::subscription::subscription(const route& reply_to, uint32_t id,
+    const binary& prefix_filter, uint8_t options,
+    const asio::time_point& expires)
+  : reply_to(reply_to),
+    id(id),
+    prefix_filter(prefix_filter),
+    options(options),
+    sequence(0),
+    expires(expires),
+    confirmed(true)
+{
+}
+
+void address_index::subscription::remember(const hash_digest& tx_hash)
+{
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!delivered_.insert(tx_hash).second)
+        return;
+
+    delivered_order_.push_back(tx_hash);
+
+    if (delivered_order_.size() > delivered_limit)
+    {
+        delivered_.erase(delivered_order_.front());
+        delivered_order_.pop_front();
+    }
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// The order entry remains until it ages out, which is harmless.
+bool address_index::subscription::forget(const hash_digest& tx_hash)
+{
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(mutex_);
+    return delivered_.erase(tx_hash) != 0;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+address_index::node::node(const binary& prefix)
+  : prefix(prefix)
+{
+}
+
+address_index::address_index(size_t limit, const asio::duration& horizon)
+  : limit_(limit),
+    resolution_(std::max(asio::duration(horizon / wheel_slots),
+        minimum_resolution)),
+    origin_(asio::steady_clock::now()),
+    size_(0),
+    stopped_(false),
+    root_(binary{}),
+    inner_(wheel_slots),
+    outer_(wheel_slots),
+    cursor_(0)
+{
+}
+
+size_t address_index::size() const
+{
+    return size_.load();
+}
+
+asio::duration address_index::resolution() const
+{
+    return resolution_;
+}
+
+// Subscribe.
+// ----------------------------------------------------------------------------
+
+bool address_index::subscribe(const route& reply_to, uint32_t id,
+    const binary& prefix_filter, const asio::duration& duration,
+    uint8_t options)
+{
+    const auto expires = asio::steady_clock::now() + duration;
+
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    unique_lock lock(mutex_);
+
+    if (stopped_)
+        return false;
+
+    const auto existing = find(root_, prefix_filter);
+
+    if (existing != nullptr)
+    {
+        const auto it = existing->entries.find(reply_to);
+
+        // Renew the existing subscription, its wheel entry moves when due.
+        // Renewal confirms that the route of a restored subscription is live.
+        if (it != existing->entries.end())
+        {
+            it->second->expires = expires;
+            it->second->confirmed = true;
+            return true;
+        }
+    }
+
+    if (limit_ > 0 && size_.load() >= limit_)
+        return false;
+
+    const auto entry = std::make_shared<subscription>(reply_to, id,
+        prefix_filter, options, expires);
+
+    insert(root_, entry);
+    schedule(entry);
+    ++size_;
+    return true;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+address_index::subscription::ptr address_index::unsubscribe(
+    const route& reply_to, const binary& prefix_filter)
+{
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    unique_lock lock(mutex_);
+
+    // The wheel entry is dropped when its slot is reached.
+    const auto entry = erase(root_, reply_to, prefix_filter);
+
+    if (entry)
+        --size_;
+
+    return entry;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+void address_index::unsubscribe(const route& reply_to,
+    subscription::list& out)
+{
+    const auto start = out.size();
+
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    unique_lock lock(mutex_);
+
+    // The wheel entries are dropped when their slots are reached.
+    collect(root_, reply_to, out);
+    size_ -= out.size() - start;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// Match.
+// ----------------------------------------------------------------------------
+
+// Each node on the path of the field has a prefix that is a prefix of field.
+void address_index::match(subscription::list& out, const binary& field) const
+{
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    shared_lock lock(mutex_);
+
+    auto current = &root_;
+
+    while (true)
+    {
+        for (const auto& entry: current->entries)
+            if (entry.second->confirmed)
+                out.push_back(entry.second);
+
+        const auto position = current->prefix.size();
+
+        if (position >= field.size())
+            break;
+
+        const auto& slot = current->children[branch(field, position)];
+
+        if (!slot || !slot->prefix.is_prefix_of(field))
+            break;
+
+        current = slot.get();
+    }
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// Expiration.
+// ----------------------------------------------------------------------------
+
+void address_index::purge(subscription::list& out)
+{
+    purge(out, asio::steady_clock::now());
+}
+
+void address_index::purge(subscription::list& out,
+    const asio::time_point& now)
+{
+    const auto start = out.size();
+
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    unique_lock lock(mutex_);
+
+    const auto current = tick(now);
+
+    // Slots repeat after a full revolution, so no more than that is visited.
+    const auto first = current - std::min(current, wheel_slots - 1);
+
+    // Revolutions begun in the skipped ticks are cascaded from the first.
+    if (first > cursor_)
+    {
+        const auto revolution = cursor_ / wheel_slots + 1;
+        const auto last = (first - 1) / wheel_slots;
+        cursor_ = first;
+
+        if (last >= revolution)
+            cascade(revolution, last);
+    }
+
+    for (; cursor_ <= current; ++cursor_)
+    {
+        // Each revolution begins by cascading its outer slot.
+        if (cursor_ % wheel_slots == 0)
+            cascade(cursor_ / wheel_slots, cursor_ / wheel_slots);
+
+        subscription::list slot;
+        slot.swap(inner_[cursor_ % wheel_slots]);
+        expire(slot, now, out);
+    }
+
+    // The current tick is revisited, as it may yet contain later deadlines.
+    cursor_ = current;
+    size_ -= out.size() - start;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+void address_index::stop(subscription::list& out)
+{
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    unique_lock lock(mutex_);
+
+    stopped_ = true;
+    collect(root_, out);
+    size_ = 0;
+
+    for (auto& slot: inner_)
+        subscription::list().swap(slot);
+
+    for (auto& slot: outer_)
+        subscription::list().swap(slot);
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// Snapshot.
+// ----------------------------------------------------------------------------
+// [ version:1 ]
+// [ saved:8 ] (seconds since the system clock epoch)
+// [ count:varint ]
+// count * [ secure:1 ][ delimited:1 ][ address1:varint+ ][ address2:varint+ ]
+//         [ id:4 ][ prefix_bits:varint ][ prefix:... ][ options:1 ]
+//         [ sequence:1 ][ remaining_milliseconds:8 ]
+// This is a stream, not a memory-mappable table. Routes and prefixes are of
+// variable length, and the snapshot is read once on start into the trie and
+// wheels (which hold pointers), so fixed records would only add padding.
+
+bool address_index::from_data(reader& source,
+    const asio::duration& expiration)
+{
+    if (source.read_byte() != snapshot_version)
+        return false;
+
+    const auto saved = std::chrono::system_clock::time_point(
+        std::chrono::seconds(source.read_8_bytes_little_endian()));
+
+    // The steady clock cannot span restarts, so downtime is by system clock.
+    const auto downtime = std::max(std::chrono::system_clock::now() - saved,
+        std::chrono::system_clock::duration::zero());
+
+    const auto now = asio::steady_clock::now();
+    const auto count = source.read_size_little_endian();
+
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    unique_lock lock(mutex_);
+
+    for (size_t entry = 0; entry < count && source; ++entry)
+    {
+        // Lengths are bounded before reading, so corruption cannot allocate.
+        route reply_to;
+        reply_to.secure = source.read_byte() != 0;
+        reply_to.delimited = source.read_byte() != 0;
+        const auto address1_size = source.read_size_little_endian();
+
+        if (address1_size > maximum_address_size)
+            return false;
+
+        reply_to.address1 = source.read_bytes(address1_size);
+        const auto address2_size = source.read_size_little_endian();
+
+        if (address2_size > maximum_address_size)
+            return false;
+
+        reply_to.address2 = source.read_bytes(address2_size);
+        const auto id = source.read_4_bytes_little_endian();
+        const auto bits = source.read_size_little_endian();
+
+        if (bits > maximum_prefix_bits)
+            return false;
+
+        const auto blocks = source.read_bytes(binary::blocks_size(bits));
+        const auto options = source.read_byte();
+        const auto sequence = source.read_byte();
+        const auto remaining = std::chrono::duration_cast<asio::duration>(
+            asio::milliseconds(source.read_8_bytes_little_endian()));
+
+        if (!source)
+            break;
+
+        if (stopped_ || remaining <= downtime ||
+            (limit_ > 0 && size_.load() >= limit_))
+            continue;
+
+        const binary prefix_filter(bits, blocks);
+        const auto left = std::min(expiration,
+            std::chrono::duration_cast<asio::duration>(remaining - downtime));
+        const auto existing = find(root_, prefix_filter);
+
+        if (existing != nullptr &&
+            existing->entries.find(reply_to) != existing->entries.end())
+            continue;
+
+        const auto item = std::make_shared<subscription>(reply_to, id,
+            prefix_filter, options, now + left);
+        item->sequence = sequence;
+        item->confirmed = false;
+
+        insert(root_, item);
+        schedule(item);
+        ++size_;
+    }
+
+    return static_cast<bool>(source);
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+void address_index::to_data(writer& sink) const
+{
+    using namespace std::chrono;
+    const auto saved = duration_cast<seconds>(
+        system_clock::now().time_since_epoch());
+
+    subscription::list entries;
+    const auto now = asio::steady_clock::now();
+
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    shared_lock lock(mutex_);
+
+    enumerate(root_, entries);
+
+    sink.write_byte(snapshot_version);
+    sink.write_8_bytes_little_endian(saved.count());
+    sink.write_size_little_endian(entries.size());
+
+    for (const auto& entry: entries)
+    {
+        const auto& reply_to = entry->reply_to;
+        const auto remaining = duration_cast<milliseconds>(
+            std::max(entry->expires - now, asio::duration::zero()));
+
+        sink.write_byte(reply_to.secure ? 1 : 0);
+        sink.write_byte(reply_to.delimited ? 1 : 0);
+        sink.write_size_little_endian(reply_to.address1.size());
+        sink.write_bytes(reply_to.address1);
+        sink.write_size_little_endian(reply_to.address2.size());
+        sink.write_bytes(reply_to.address2);
+        sink.write_4_bytes_little_endian(entry->id);
+        sink.write_size_little_endian(entry->prefix_filter.size());
+        sink.write_bytes(entry->prefix_filter.blocks());
+        sink.write_byte(entry->options);
+        sink.write_byte(entry->sequence.load());
+        sink.write_8_bytes_little_endian(remaining.count());
+    }
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// Trie operations (must be called under lock).
+// ----------------------------------------------------------------------------
+
+address_index::node* address_index::find(node& parent,
+    const binary& prefix_filter)
+{
+    auto current = &parent;
+
+    while (current->prefix.size() < prefix_filter.size())
+    {
+        const auto position = current->prefix.size();
+        const auto& slot = current->children[branch(prefix_filter, position)];
+
+        if (!slot || !slot->prefix.is_prefix_of(prefix_filter))
+            return nullptr;
+
+        current = slot.get();
+    }
+
+    return current;
+}
+
+void address_index::insert(node& parent, subscription::ptr entry)
+{
+    const auto& prefix_filter = entry->prefix_filter;
+    auto current = &parent;
+
+    while (current->prefix.size() != prefix_filter.size())
+    {
+        const auto position = current->prefix.size();
+        auto& slot = current->children[branch(prefix_filter, position)];
+
+        // There is no node on this branch, so add a leaf.
+        if (!slot)
+        {
+            slot.reset(new node(prefix_filter));
+            current = slot.get();
+            break;
+        }
+
+        const auto common = common_bits(slot->prefix, prefix_filter);
+
+        // The child prefix is a prefix of the filter, so descend.
+        if (common == slot->prefix.size())
+        {
+            current = slot.get();
+            continue;
+        }
+
+        // Split the edge at the first differing bit (or end of the filter).
+        node::ptr split(new node(prefix_filter.substring(0, common)));
+        split->children[branch(slot->prefix, common)] = std::move(slot);
+        slot = std::move(split);
+        current = slot.get();
+    }
+
+    current->entries.emplace(entry->reply_to, entry);
+}
+
+address_index::subscription::ptr address_index::erase(node& parent,
+    const route& reply_to, const binary& prefix_filter)
+{
+    const auto position = parent.prefix.size();
+
+    if (position == prefix_filter.size())
+    {
+        const auto it = parent.entries.find(reply_to);
+
+        if (it == parent.entries.end())
+            return nullptr;
+
+        const auto entry = it->second;
+        parent.entries.erase(it);
+        return entry;
+    }
+
+    auto& slot = parent.children[branch(prefix_filter, position)];
+
+    if (!slot || !slot->prefix.is_prefix_of(prefix_filter))
+        return nullptr;
+
+    const auto entry = erase(*slot, reply_to, prefix_filter);
+
+    if (entry)
+        compact(slot);
+
+    return entry;
+}
+
+void address_index::collect(node& parent, subscription::list& out)
+{
+    for (const auto& entry: parent.entries)
+        out.push_back(entry.second);
+
+    parent.entries.clear();
+
+    for (auto& slot: parent.children)
+    {
+        if (slot)
+        {
+            collect(*slot, out);
+            slot.reset();
+        }
+    }
+}
+
+void address_index::collect(node& parent, const route& reply_to,
+    subscription::list& out)
+{
+    const auto it = parent.entries.find(reply_to);
+
+    if (it != parent.entries.end())
+    {
+        out.push_back(it->second);
+        parent.entries.erase(it);
+    }
+
+    for (auto& slot: parent.children)
+    {
+        if (slot)
+        {
+            collect(*slot, reply_to, out);
+            compact(slot);
+        }
+    }
+}
+
+void address_index::enumerate(const node& parent, subscription::list& out)
+{
+    for (const auto& entry: parent.entries)
+        out.push_back(entry.second);
+
+    for (const auto& slot: parent.children)
+        if (slot)
+            enumerate(*slot, out);
+}
+
+// Remove a node without subscriptions or replace it with its only child.
+void address_index::compact(node::ptr& slot)
+{
+    if (!slot->entries.empty())
+        return;
+
+    auto& left = slot->children[0];
+    auto& right = slot->children[1];
+
+    if (left && right)
+        return;
+
+    // The surviving child (if any) holds its full prefix, so may move up.
+    node::ptr child(std::move(left ? left : right));
+    slot = std::move(child);
+}
+
+// Timer wheel operations (must be called under lock).
+// ----------------------------------------------------------------------------
+
+uint64_t address_index::tick(const asio::time_point& time) const
+{
+    return static_cast<uint64_t>((time - origin_) / resolution_);
+}
+
+// Deadlines within a revolution of the cursor are placed by tick, later
+// deadlines by revolution. Deadlines beyond the outer wheel are placed in its
+// last slot and rescheduled when it cascades.
+void address_index::schedule(subscription::ptr entry)
+{
+    const auto due = std::max(tick(entry->expires), cursor_);
+
+    if (due < cursor_ + wheel_slots)
+    {
+        inner_[due % wheel_slots].push_back(entry);
+        return;
+    }
+
+    const auto last = cursor_ / wheel_slots + wheel_slots - 1;
+    const auto revolution = std::min(due / wheel_slots, last);
+    outer_[revolution % wheel_slots].push_back(entry);
+}
+
+// Move the outer slots of the revolutions to the inner wheel. All slots are
+// emptied before any entry is rescheduled, so no entry returns to a slot that
+// is being cascaded. Unsubscribed entries are dropped.
+void address_index::cascade(uint64_t first, uint64_t last)
+{
+    subscription::list entries;
+    last = std::min(last, first + wheel_slots - 1);
+
+    for (auto revolution = first; revolution <= last; ++revolution)
+    {
+        auto& slot = outer_[revolution % wheel_slots];
+        entries.insert(entries.end(), slot.begin(), slot.end());
+        subscription::list().swap(slot);
+    }
+
+    for (auto& entry: entries)
+        if (indexed(*entry))
+            schedule(entry);
+}
+
+void address_index::expire(subscription::list& slot,
+    const asio::time_point& now, subscription::list& out)
+{
+    for (auto& entry: slot)
+    {
+        // The entry was unsubscribed (and possibly replaced).
+        if (!indexed(*entry))
+            continue;
+
+        // The entry was renewed since it was scheduled.
+        if (entry->expires > now)
+        {
+            schedule(entry);
+            continue;
+        }
+
+        erase(root_, entry->reply_to, entry->prefix_filter);
+        out.push_back(entry);
+    }
+}
+
+bool address_index::indexed(const subscription& entry)
+{
+    const auto parent = find(root_, entry.prefix_filter);
+
+    if (parent == nullptr)
+        return false;
+
+    const auto it = parent->entries.find(entry.reply_to);
+    return it != parent->entries.end() && it->second.get() == &entry;
+}
+
+} // namespace server
+} // namespace libbitcoin
@@ -0,0 +1,70 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/server/utility/chain_tip.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <bitcoin/bitcoin.hpp>
+
+namespace libbitcoin {
+namespace server {
+
+chain_tip::chain_tip()
+  : tip_(nullptr)
+{
+}
+
+chain_tip::ptr chain_tip::get() const
+{
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    shared_lock lock(mutex_);
+    return tip_;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+void chain_tip::initialize(size_t height, const chain::header& header)
+{
+    const auto tip = std::make_shared<const snapshot>(
+        snapshot{ height, header.hash(), header });
+
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    unique_lock lock(mutex_);
+
+    if (!tip_)
+        tip_ = tip;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// The snapshot is built outside of the lock, readers only copy the pointer.
+void chain_tip::set(size_t height, const chain::header& header)
+{
+    const auto tip = std::make_shared<const snapshot>(
+        snapshot{ height, header.hash(), header });
+
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    unique_lock lock(mutex_);
+    tip_ = tip;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+} // namespace server
+} // namespace libbitcoin
@@ -20,6 +20,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <utility>
 #include <bitcoin/blockchain.hpp>
 #include <bitcoin/server/configuration.hpp>
 #include <bitcoin/server/messages/message.hpp>
@@ -77,14 +78,15 @@ void send_history_result(const code& ec,
     {
         BITCOIN_ASSERT(row.height <= max_uint32);
         serial.write_byte(static_cast<uint8_t>(row.kind));
-        serial.write_bytes(row.point.to_data());
+        serial.write_hash(row.point.hash());
+        serial.write_4_bytes_little_endian(row.point.index());
         serial.write_4_bytes_little_endian(row.height);
         serial.write_8_bytes_little_endian(row.value);
     }
 
     ////BITCOIN_ASSERT(serial.iterator() == result.end());
 
-    handler(message(request, result));
+    handler(message(request, std::move(result)));
 }
 
 // fetch_transaction stuff
@@ -109,13 +111,16 @@ bool unwrap_fetch_transaction_args(hash_digest& hash, const message& request)
 void transaction_fetched(const code& ec, transaction_ptr tx, size_t, size_t,
     const message& request, send_handler handler)
 {
-    const auto result = build_chunk(
-    {
-        message::to_bytes(ec),
-        tx->to_data()
-    });
+    // [ code:4 ]
+    // [ transaction... ]
+    data_chunk result(code_size + (ec ? 0 : tx->serialized_size()));
+    auto serial = make_unsafe_serializer(result.begin());
+    serial.write_error_code(ec);
+
+    if (!ec)
+        tx->to_data(serial);
 
-    handler(message(request, result));
+    handler(message(request, std::move(result)));
 }
 
 } // namespace server
@@ -0,0 +1,198 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/server/utility/output_cache.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <bitcoin/bitcoin.hpp>
+
+namespace libbitcoin {
+namespace server {
+
+using namespace bc::chain;
+
+// Addresses are evicted (least recently used first) above this limit.
+static constexpr size_t maximum_rows = 1000000;
+
+output_cache::output_cache()
+  : rows_(0), epoch_(0)
+{
+}
+
+// static
+// A checksum spent at more than one height takes the lowest (deepest).
+output_cache::list_ptr output_cache::to_outputs(
+    const history_compact::list& history)
+{
+    std::unordered_map<uint64_t, size_t> spends;
+    const auto outputs = std::make_shared<list>();
+
+    for (const auto& row: history)
+    {
+        if (row.kind != point_kind::spend)
+            continue;
+
+        const auto it = spends.emplace(row.previous_checksum, row.height);
+
+        if (!it.second)
+            it.first->second = std::min(it.first->second, row.height);
+    }
+
+    for (const auto& row: history)
+    {
+        if (row.kind != point_kind::output)
+            continue;
+
+        const auto spend = spends.find(row.point.checksum());
+        const auto spent = spend != spends.end();
+        outputs->push_back({ row.point, row.height, row.value, spent,
+            spent ? spend->second : 0 });
+    }
+
+    return outputs;
+}
+
+size_t output_cache::epoch() const
+{
+    return epoch_.load();
+}
+
+output_cache::list_ptr output_cache::find(const short_hash& address_hash)
+{
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = addresses_.find(address_hash);
+
+    if (it == addresses_.end())
+        return nullptr;
+
+    // Move the entry to the front (most recently used).
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->outputs;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// A history above the row limit is not cached.
+void output_cache::store(const short_hash& address_hash, list_ptr outputs,
+    size_t epoch)
+{
+    if (outputs->size() > maximum_rows)
+        return;
+
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // The epoch is tested under the lock, so an invalidation that follows a
+    // successful test also discards the stored outputs.
+    if (epoch != epoch_.load() ||
+        addresses_.find(address_hash) != addresses_.end())
+        return;
+
+    entries_.push_front({ address_hash, outputs });
+    addresses_.emplace(address_hash, entries_.begin());
+    rows_ += outputs->size();
+    evict();
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// Addresses are extracted as by the database history index (see
+// transaction_fields::extract), the extraction is cached by the database.
+void output_cache::invalidate(const block& block)
+{
+    std::unordered_set<short_hash> hashes;
+
+    for (const auto& tx: block.transactions())
+    {
+        for (const auto& input: tx.inputs())
+        {
+            const auto address = input.address();
+
+            if (address)
+                hashes.insert(address.hash());
+        }
+
+        for (const auto& output: tx.outputs())
+        {
+            const auto address = output.address();
+
+            if (address)
+                hashes.insert(address.hash());
+        }
+    }
+
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Outputs in flight are rejected by store.
+    ++epoch_;
+
+    for (const auto& hash: hashes)
+        erase(hash);
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+void output_cache::clear()
+{
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Outputs in flight are rejected by store.
+    ++epoch_;
+    entries_.clear();
+    addresses_.clear();
+    rows_ = 0;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// Called under the lock.
+void output_cache::erase(const short_hash& address_hash)
+{
+    const auto it = addresses_.find(address_hash);
+
+    if (it == addresses_.end())
+        return;
+
+    rows_ -= it->second->outputs->size();
+    entries_.erase(it->second);
+    addresses_.erase(it);
+}
+
+// Called under the lock.
+void output_cache::evict()
+{
+    while (rows_ > maximum_rows)
+    {
+        const auto& last = entries_.back();
+        rows_ -= last.outputs->size();
+        addresses_.erase(last.address_hash);
+        entries_.pop_back();
+    }
+}
+
+} // namespace server
+} // namespace libbitcoin
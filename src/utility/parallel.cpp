@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/server/utility/parallel.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <bitcoin/bitcoin.hpp>
+
+namespace libbitcoin {
+namespace server {
+
+// Work is partitioned into ranges of at least this many items.
+static constexpr size_t minimum_range = 64;
+
+// Shared by the caller and any posted handlers, which may outlive the call.
+struct partition
+{
+    partition(size_t count, size_t ranges)
+      : count(count), ranges(ranges), size((count + ranges - 1) / ranges),
+        next(0), completed(0)
+    {
+    }
+
+    const size_t count;
+    const size_t ranges;
+    const size_t size;
+    std::atomic<size_t> next;
+    size_t completed;
+    std::mutex mutex;
+    std::condition_variable done;
+};
+
+// Claim and complete ranges until none remain.
+static void run(std::shared_ptr<partition> shared, range_handler handler)
+{
+    for (auto range = shared->next++; range < shared->ranges;
+        range = shared->next++)
+    {
+        const auto first = range * shared->size;
+        const auto last = std::min(first + shared->size, shared->count);
+        handler(first, last);
+
+        // Critical Section
+        ///////////////////////////////////////////////////////////////////////
+        std::unique_lock<std::mutex> lock(shared->mutex);
+
+        if (++shared->completed == shared->ranges)
+            shared->done.notify_one();
+        ///////////////////////////////////////////////////////////////////////
+    }
+}
+
+void parallel_for(threadpool& pool, size_t count, size_t parallelism,
+    range_handler handler)
+{
+    const auto ranges = std::min((count + minimum_range - 1) / minimum_range,
+        parallelism);
+
+    if (ranges <= 1)
+    {
+        handler(0, count);
+        return;
+    }
+
+    const auto shared = std::make_shared<partition>(count, ranges);
+
+    // Posted handlers that find no remaining range exit immediately.
+    for (size_t range = 1; range < ranges; ++range)
+        pool.service().post(std::bind(run, shared, handler));
+
+    run(shared, handler);
+
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    std::unique_lock<std::mutex> lock(shared->mutex);
+
+    while (shared->completed < shared->ranges)
+        shared->done.wait(lock);
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+void parallel_post(threadpool& pool, size_t count, size_t parallelism,
+    range_handler handler)
+{
+    const auto ranges = std::max(std::min(count, parallelism), size_t(1));
+    const auto size = (count + ranges - 1) / ranges;
+
+    for (size_t first = 0; first < count; first += size)
+        pool.service().post(std::bind(handler, first,
+            std::min(first + size, count)));
+}
+
+concurrency_limit::concurrency_limit(size_t limit)
+  : limit_(limit), count_(0)
+{
+}
+
+bool concurrency_limit::try_acquire()
+{
+    auto count = count_.load();
+
+    do
+    {
+        if (count >= limit_)
+            return false;
+    } while (!count_.compare_exchange_weak(count, count + 1));
+
+    return true;
+}
+
+void concurrency_limit::release()
+{
+    BITCOIN_ASSERT(count_.load() > 0);
+    --count_;
+}
+
+} // namespace server
+} // namespace libbitcoin
@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/server/utility/request_coalescer.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <bitcoin/bitcoin.hpp>
+#include <bitcoin/server/messages/message.hpp>
+
+namespace libbitcoin {
+namespace server {
+
+request_coalescer::request_coalescer(const asio::duration& timeout)
+  : timeout_(timeout)
+{
+}
+
+// The epoch is fixed size and the command is terminated, so distinct epochs
+// and commands never share a key.
+std::string request_coalescer::to_key(const message& request, size_t epoch)
+{
+    const auto& data = request.data();
+    const auto epoch64 = static_cast<uint64_t>(epoch);
+    std::string key(reinterpret_cast<const char*>(&epoch64), sizeof(epoch64));
+    key.append(request.command());
+    key.push_back('\0');
+    key.append(data.begin(), data.end());
+    return key;
+}
+
+bool request_coalescer::attach(const message& request, send_handler handler,
+    size_t epoch)
+{
+    return attach(request, handler, epoch, asio::steady_clock::now());
+}
+
+// A timed out request remains registered (with its attached requests), and
+// is restarted by this request, whose completion then answers all of them.
+bool request_coalescer::attach(const message& request, send_handler handler,
+    size_t epoch, const asio::time_point& now)
+{
+    auto key = to_key(request, epoch);
+
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = pending_.find(key);
+
+    if (it == pending_.end())
+    {
+        pending_.emplace(std::move(key), pending{ now, requester_list{} });
+        return false;
+    }
+
+    if (now - it->second.started > timeout_)
+    {
+        it->second.started = now;
+        return false;
+    }
+
+    it->second.requesters.emplace_back(request, handler);
+    return true;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// Each attached request is answered with its own route and correlation id,
+// and shares the response payload.
+void request_coalescer::complete(const message& request, size_t epoch,
+    message::chunk_ptr response)
+{
+    requester_list requesters;
+    const auto key = to_key(request, epoch);
+
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto it = pending_.find(key);
+
+        if (it != pending_.end())
+        {
+            requesters.swap(it->second.requesters);
+            pending_.erase(it);
+        }
+    }
+    ///////////////////////////////////////////////////////////////////////////
+
+    for (const auto& requester: requesters)
+        requester.second(message(requester.first, response));
+}
+
+} // namespace server
+} // namespace libbitcoin
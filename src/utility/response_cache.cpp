@@ -0,0 +1,188 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/server/utility/response_cache.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <bitcoin/bitcoin.hpp>
+
+namespace libbitcoin {
+namespace server {
+
+// Keys are distributed over this many independently locked shards.
+static constexpr size_t shard_count = 16;
+
+// Each entry is charged its key, response and a bookkeeping estimate.
+static constexpr size_t entry_overhead = 64;
+
+const size_t response_cache::any_height = max_size_t;
+
+response_cache::response_cache(size_t capacity)
+  : shard_capacity_(capacity / shard_count),
+    shards_(shard_capacity_ == 0 ? 0 : shard_count),
+    epoch_(0),
+    hits_(0),
+    misses_(0)
+{
+}
+
+bool response_cache::enabled() const
+{
+    return !shards_.empty();
+}
+
+size_t response_cache::epoch() const
+{
+    return epoch_.load();
+}
+
+// The command is terminated, so distinct commands never share a key.
+std::string response_cache::to_key(const std::string& command,
+    const data_chunk& request)
+{
+    std::string key(command);
+    key.push_back('\0');
+    key.append(request.begin(), request.end());
+    return key;
+}
+
+response_cache::shard& response_cache::to_shard(const std::string& key)
+{
+    return shards_[std::hash<std::string>()(key) % shards_.size()];
+}
+
+bool response_cache::find(chunk_ptr& out_response,
+    const std::string& command, const data_chunk& request)
+{
+    if (!enabled())
+        return false;
+
+    const auto key = to_key(command, request);
+    auto& shard = to_shard(key);
+
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    const auto it = shard.keys.find(key);
+    const auto found = (it != shard.keys.end());
+
+    if (found)
+    {
+        // Move the entry to the front (most recently used).
+        shard.entries.splice(shard.entries.begin(), shard.entries,
+            it->second);
+        out_response = it->second->response;
+    }
+
+    lock.unlock();
+    ///////////////////////////////////////////////////////////////////////////
+
+    ++(found ? hits_ : misses_);
+    return found;
+}
+
+void response_cache::store(const std::string& command,
+    const data_chunk& request, chunk_ptr response, size_t height,
+    size_t epoch)
+{
+    if (!enabled())
+        return;
+
+    auto key = to_key(command, request);
+    const auto size = key.size() + response->size() + entry_overhead;
+
+    if (size > shard_capacity_)
+        return;
+
+    auto& shard = to_shard(key);
+
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    // The epoch is tested under the shard lock, so an invalidation that
+    // follows a successful test also purges the stored response.
+    if (epoch != epoch_.load() || shard.keys.find(key) != shard.keys.end())
+        return;
+
+    shard.entries.push_front({ std::move(key), response, height });
+    shard.keys.emplace(shard.entries.front().key, shard.entries.begin());
+    shard.size += size;
+    evict(shard);
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// Called under the shard lock.
+void response_cache::evict(shard& shard)
+{
+    while (shard.size > shard_capacity_)
+    {
+        const auto& last = shard.entries.back();
+        shard.size -= last.key.size() + last.response->size() + entry_overhead;
+        shard.keys.erase(last.key);
+        shard.entries.pop_back();
+    }
+}
+
+void response_cache::invalidate(size_t fork_height)
+{
+    // Responses in flight are rejected by store (and not coalesced with).
+    // The epoch is advanced even if disabled, as the coalescer keys on it.
+    ++epoch_;
+
+    if (!enabled())
+        return;
+
+    for (auto& shard: shards_)
+    {
+        // Critical Section
+        ///////////////////////////////////////////////////////////////////////
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        for (auto it = shard.entries.begin(); it != shard.entries.end();)
+        {
+            if (it->height <= fork_height)
+            {
+                ++it;
+                continue;
+            }
+
+            shard.size -= it->key.size() + it->response->size() +
+                entry_overhead;
+            shard.keys.erase(it->key);
+            it = shard.entries.erase(it);
+        }
+        ///////////////////////////////////////////////////////////////////////
+    }
+}
+
+size_t response_cache::hits() const
+{
+    return hits_.load();
+}
+
+size_t response_cache::misses() const
+{
+    return misses_.load();
+}
+
+} // namespace server
+} // namespace libbitcoin
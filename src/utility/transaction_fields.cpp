@@ -0,0 +1,152 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <bitcoin/server/utility/transaction_fields.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <bitcoin/bitcoin.hpp>
+
+namespace libbitcoin {
+namespace server {
+
+using namespace bc::chain;
+using namespace bc::wallet;
+
+transaction_fields::transaction_fields(const chain::transaction& tx)
+  : tx_(tx), fields_(extract(tx))
+{
+}
+
+const chain::transaction& transaction_fields::transaction() const
+{
+    return tx_;
+}
+
+const transaction_fields::field_list& transaction_fields::fields() const
+{
+    return fields_;
+}
+
+// Input values are available only if the previous output was cached during
+// validation, which is the case for relayed pool and block transactions.
+uint64_t transaction_fields::value(const field& field) const
+{
+    switch (field.kind)
+    {
+        case kind::input:
+            return tx_.inputs()[field.index].previous_output().validation
+                .cache.value();
+        case kind::output:
+        case kind::stealth:
+        default:
+            return tx_.outputs()[field.index].value();
+    }
+}
+
+// The chunk is never replaced, so the reference remains valid.
+const data_chunk& transaction_fields::data() const
+{
+    return *shared_data();
+}
+
+// Serialization is deferred as most transactions match no subscription.
+transaction_fields::chunk_ptr transaction_fields::shared_data() const
+{
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    mutex_.lock_upgrade();
+
+    if (!data_)
+    {
+        //+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+        mutex_.unlock_upgrade_and_lock();
+        data_ = std::make_shared<const data_chunk>(tx_.to_data());
+        mutex_.unlock_and_lock_upgrade();
+        //---------------------------------------------------------------------
+    }
+
+    const auto data = data_;
+    mutex_.unlock_upgrade();
+    ///////////////////////////////////////////////////////////////////////////
+
+    return data;
+}
+
+// This parsing is duplicated by bc::database::data_base.
+transaction_fields::field_list transaction_fields::extract(
+    const chain::transaction& tx)
+{
+    uint32_t prefix;
+
+    // TODO: move full integer and array constructors into binary.
+    static constexpr size_t prefix_bits = sizeof(prefix) * byte_bits;
+    static constexpr size_t address_bits = short_hash_size * byte_bits;
+    const auto& outputs = tx.outputs();
+    const auto& inputs = tx.inputs();
+    field_list fields;
+
+    if (outputs.empty())
+        return fields;
+
+    // see data_base::push_inputs
+    // Loop inputs and extract payment addresses.
+    for (uint32_t index = 0; index < inputs.size(); ++index)
+    {
+        // This is cached by database extraction (if indexed).
+        const auto address = inputs[index].address();
+
+        if (address)
+            fields.push_back({ { address_bits, address.hash() }, kind::input,
+                index });
+    }
+
+    // see data_base::push_outputs
+    // Loop outputs and extract payment addresses.
+    for (uint32_t index = 0; index < outputs.size(); ++index)
+    {
+        // This is cached by database extraction (if indexed).
+        const auto address = outputs[index].address();
+
+        if (address)
+            fields.push_back({ { address_bits, address.hash() }, kind::output,
+                index });
+    }
+
+    // see data_base::push_stealth
+    // Loop output pairs and extract stealth payments.
+    for (uint32_t index = 0; index < (outputs.size() - 1); ++index)
+    {
+        const auto& ephemeral_script = outputs[index].script();
+        const auto& payment_output = outputs[index + 1];
+
+        // Try to extract a stealth prefix from the first output.
+        // Try to extract the payment address from the second output.
+        // The address is cached by database extraction (if indexed).
+        if (payment_output.address() &&
+            to_stealth_prefix(prefix, ephemeral_script))
+            fields.push_back({ { prefix_bits, to_little_endian(prefix) },
+                kind::stealth, index + 1 });
+    }
+
+    return fields;
+}
+
+} // namespace server
+} // namespace libbitcoin
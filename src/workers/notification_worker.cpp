@@ -19,10 +19,14 @@
 #include <bitcoin/server/workers/notification_worker.hpp>
 
 #include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <bitcoin/protocol.hpp>
 #include <bitcoin/server/define.hpp>
@@ -32,6 +36,8 @@
 #include <bitcoin/server/services/query_service.hpp>
 #include <bitcoin/server/settings.hpp>
 #include <bitcoin/server/utility/fetch_helpers.hpp>
+#include <bitcoin/server/utility/parallel.hpp>
+#include <bitcoin/server/utility/transaction_fields.hpp>
 
 namespace libbitcoin {
 namespace server {
@@ -43,14 +49,28 @@ using namespace bc::chain;
 using namespace bc::protocol;
 using namespace bc::wallet;
 
-// Purge subscriptions at 10% of the expiration period.
-static constexpr int64_t purge_interval_ratio = 10;
+// The poller waits at most this long, which avoids poller failure.
+static constexpr int32_t maximum_wait_milliseconds = 1000;
+
+// The most notifications sent to one client per drain.
+static constexpr size_t client_burst = 100;
+
+// A client at high water in the query service is not sent to for this long.
+static const asio::duration blocked_client_delay = asio::milliseconds(100);
+
+// Batched pool notifications are sent this often.
+static const asio::duration pool_batch_interval = asio::seconds(1);
+
+// Client queue statistics are logged this often.
+static const asio::duration report_interval = asio::seconds(60);
 
 // Notifications respond with commands that are distinct from the subscription.
 ////static const std::string penetration_update("penetration.update");
 ////static const std::string address_stealth("address.stealth_update");
 ////static const std::string address_update("address.update");
 static const std::string address_update2("address.update2");
+static const std::string address_update3("address.update3");
+static const std::string address_rollback("address.rollback");
 
 notification_worker::notification_worker(zmq::authenticator& authenticator,
     server_node& node, bool secure)
@@ -59,8 +79,11 @@ notification_worker::notification_worker(zmq::authenticator& authenticator,
     settings_(node.server_settings()),
     node_(node),
     authenticator_(authenticator),
-    address_subscriber_(std::make_shared<address_subscriber>(
-        node.thread_pool(), settings_.subscription_limit, NAME "_address"))
+    address_index_(settings_.subscription_limit,
+        settings_.subscription_expiration()),
+    clients_(settings_.notification_queue_depth,
+        settings_.notification_queue_policy),
+    snapshot_saved_(false)
     ////penetration_subscriber_(std::make_shared<penetration_subscriber>(
     ////    node.thread_pool(), settings_.subscription_limit, NAME "_penetration"))
 {
@@ -69,20 +92,12 @@ notification_worker::notification_worker(zmq::authenticator& authenticator,
 // There is no unsubscribe so this class shouldn't be restarted.
 bool notification_worker::start()
 {
-    // v3
-    address_subscriber_->start();
     ////penetration_subscriber_->start();
 
-    // Subscribe to blockchain reorganizations.
-    node_.subscribe_blockchain(
-        std::bind(&notification_worker::handle_reorganization,
-            this, _1, _2, _3, _4));
-
-    // Subscribe to transaction pool acceptances.
-    node_.subscribe_transaction(
-        std::bind(&notification_worker::handle_transaction_pool,
-            this, _1, _2));
+    // Restore subscriptions saved by the previous run, if enabled.
+    load_snapshot();
 
+    // Blockchain and pool notifications are extracted and relayed by the node.
     ////// BUGBUG: this API was removed as could not adapt to changing peers.
     ////// Subscribe to all inventory messages from all peers.
     ////node_.subscribe<bc::message::inventory>(
@@ -98,8 +113,12 @@ bool notification_worker::stop()
     static const auto code = error::channel_stopped;
 
     // v3
-    address_subscriber_->stop();
-    address_subscriber_->invoke(code, {}, 0, {}, {});
+    // Subscribers are notified of stop even if saved, as a restored
+    // subscription is not notified until the subscriber renews it.
+    save_snapshot();
+    subscription::list subscriptions;
+    address_index_.stop(subscriptions);
+    send_error(subscriptions, code);
 
     ////penetration_subscriber_->stop();
     ////penetration_subscriber_->invoke(code, 0, {}, {});
@@ -113,56 +132,104 @@ void notification_worker::work()
 {
     zmq::socket router(authenticator_, zmq::socket::role::router);
 
-    // Connect socket to the service endpoint.
-    if (!started(connect(router)))
+    // Connect socket to the service endpoint and open the outbox signal.
+    if (!started(connect(router) && outbox_.open(authenticator_)))
         return;
 
     zmq::poller poller;
     poller.add(router);
-    const auto interval = purge_interval_milliseconds();
-
-    // We do not send/receive on the poller, we use its timer and context stop.
-    // Other threads connect and disconnect dynamically to send updates.
+    poller.add(outbox_.signal());
+    size_t sent = 0;
+    const auto interval = address_index_.resolution();
+    auto next_purge = asio::steady_clock::now() + interval;
+    auto next_report = asio::steady_clock::now() + report_interval;
+    auto next_batch = asio::steady_clock::now() + pool_batch_interval;
+
+    // The router receives only the routes of clients at high water.
+    // Other threads queue notifications, which are all sent on this socket.
+    // The outbox signals a push, otherwise the poller waits for a timer or
+    // for a client queue that may send (beyond its burst or no longer held).
     while (!poller.terminated() && !stopped())
     {
-        // BUGBUG: this can fail on some platforms if interval is > 1000.
-        poller.wait(interval);
-        purge();
+        const auto deadline = std::min({ next_purge, next_batch,
+            next_report, clients_.next() });
+        const auto ready = poller.wait(wait_milliseconds(deadline));
+
+        if (ready.contains(router.id()))
+            receive(router);
+
+        if (ready.contains(outbox_.signal().id()))
+            outbox_.acknowledge();
+
+        sent += drain(router);
+
+        if (asio::steady_clock::now() >= next_purge)
+        {
+            purge();
+            next_purge = asio::steady_clock::now() + interval;
+        }
+
+        if (asio::steady_clock::now() >= next_batch)
+        {
+            send_pool_batches();
+            next_batch = asio::steady_clock::now() + pool_batch_interval;
+        }
+
+        if (asio::steady_clock::now() >= next_report)
+        {
+            report();
+            next_report = asio::steady_clock::now() + report_interval;
+        }
     }
 
+    // Flush notifications queued during stop (e.g. subscription termination).
+    send_pool_batches();
+
+    for (auto count = drain(router); count > 0; count = drain(router))
+        sent += count;
+
+    // Context termination ends the worker without a call to stop.
+    save_snapshot();
+    outbox_.close();
+
+    // Each of these previously required a socket connect and disconnect.
+    LOG_DEBUG(LOG_SERVER)
+        << "Sent " << sent << " " << (secure_ ? "secure" : "public")
+        << " notifications on a persistent socket (socket setups avoided).";
+
     // Disconnect the socket and exit this thread.
     finished(disconnect(router));
 }
 
-int32_t notification_worker::purge_interval_milliseconds() const
-{
-    const int64_t minutes = settings_.subscription_expiration_minutes;
-    const int64_t milliseconds = minutes * 60 * 1000 / purge_interval_ratio;
-    const auto capped = std::min(milliseconds, static_cast<int64_t>(max_int32));
-    return static_cast<int32_t>(capped);
-}
-
 // Connect/Disconnect.
 //-----------------------------------------------------------------------------
 
+// The worker is connected to the notify endpoint of each query service shard.
+// The route of a subscription begins with the identity of its shard dealers,
+// so its notifications are sent through the shard that received it.
 bool notification_worker::connect(socket& router)
 {
     const auto security = secure_ ? "secure" : "public";
-    const auto& endpoint = secure_ ? query_service::secure_notify :
-        query_service::public_notify;
-
-    const auto ec = router.connect(endpoint);
 
-    if (ec)
+    for (uint16_t shard = 0; shard < settings_.query_shards; ++shard)
     {
-        LOG_ERROR(LOG_SERVER)
-            << "Failed to connect " << security << " notification worker to "
-            << endpoint << " : " << ec.message();
-        return false;
+        const auto endpoint = query_service::notify_endpoint(secure_, shard);
+        const auto ec = router.connect(endpoint);
+
+        if (ec)
+        {
+            LOG_ERROR(LOG_SERVER)
+                << "Failed to connect " << security
+                << " notification worker to " << endpoint << " : "
+                << ec.message();
+            return false;
+        }
+
+        LOG_INFO(LOG_SERVER)
+            << "Connected " << security << " notification worker to "
+            << endpoint;
     }
 
-    LOG_INFO(LOG_SERVER)
-        << "Connected " << security << " notification worker to " << endpoint;
     return true;
 }
 
@@ -179,6 +246,130 @@ bool notification_worker::disconnect(socket& router)
     return false;
 }
 
+// Snapshot.
+// ----------------------------------------------------------------------------
+// zeromq assigns a new identity to each connection unless the client sets its
+// own, so only subscriptions of clients with stable identities will match.
+// Restored subscriptions are notified only once renewed by their subscriber,
+// which confirms the route, and otherwise expire within the expiration.
+
+boost::filesystem::path notification_worker::snapshot_file() const
+{
+    const auto name = secure_ ? "secure_subscriptions" : "public_subscriptions";
+    return settings_.subscription_snapshot_directory / name;
+}
+
+void notification_worker::load_snapshot()
+{
+    if (settings_.subscription_snapshot_directory.empty())
+        return;
+
+    const auto security = secure_ ? "secure" : "public";
+    const auto file = snapshot_file();
+    auto valid = false;
+
+    {
+        bc::ifstream stream(file.string(), std::ios::binary);
+
+        // There is no snapshot (e.g. first run).
+        if (!stream.good())
+            return;
+
+        istream_reader source(stream);
+        valid = address_index_.from_data(source,
+            settings_.subscription_expiration());
+    }
+
+    // The snapshot is consumed, so a later crash cannot restore it again.
+    // An invalid snapshot is set aside for inspection.
+    boost::system::error_code ec;
+
+    if (valid)
+    {
+        boost::filesystem::remove(file, ec);
+    }
+    else
+    {
+        auto invalid = file;
+        invalid += ".invalid";
+        boost::filesystem::rename(file, invalid, ec);
+    }
+
+    if (ec)
+        LOG_ERROR(LOG_SERVER)
+            << "Failed to remove " << security << " subscription snapshot "
+            << file << " : " << ec.message();
+
+    if (!valid)
+    {
+        LOG_WARNING(LOG_SERVER)
+            << "Invalid " << security << " subscription snapshot " << file
+            << ", restored " << address_index_.size() << " subscriptions.";
+        return;
+    }
+
+    LOG_INFO(LOG_SERVER)
+        << "Restored " << address_index_.size() << " " << security
+        << " subscriptions from " << file;
+}
+
+// The snapshot is written once, on stop or on context termination.
+bool notification_worker::save_snapshot()
+{
+    if (settings_.subscription_snapshot_directory.empty())
+        return false;
+
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    std::lock_guard<std::mutex> lock(snapshot_mutex_);
+
+    if (!snapshot_saved_)
+        snapshot_saved_ = write_snapshot();
+
+    return snapshot_saved_;
+    ///////////////////////////////////////////////////////////////////////////
+}
+
+// The file is replaced atomically so that a failed write leaves no snapshot.
+bool notification_worker::write_snapshot() const
+{
+    const auto security = secure_ ? "secure" : "public";
+    const auto file = snapshot_file();
+    auto temporary = file;
+    temporary += ".tmp";
+
+    {
+        bc::ofstream stream(temporary.string(), std::ios::binary);
+        ostream_writer sink(stream);
+        address_index_.to_data(sink);
+        stream.flush();
+
+        if (!stream.good())
+        {
+            LOG_ERROR(LOG_SERVER)
+                << "Failed to write " << security << " subscription snapshot "
+                << temporary;
+            return false;
+        }
+    }
+
+    boost::system::error_code ec;
+    boost::filesystem::rename(temporary, file, ec);
+
+    if (ec)
+    {
+        LOG_ERROR(LOG_SERVER)
+            << "Failed to replace " << security << " subscription snapshot "
+            << file << " : " << ec.message();
+        return false;
+    }
+
+    LOG_INFO(LOG_SERVER)
+        << "Saved " << address_index_.size() << " " << security
+        << " subscriptions to " << file;
+    return true;
+}
+
 // Pruning.
 // ----------------------------------------------------------------------------
 
@@ -188,89 +379,217 @@ void notification_worker::purge()
     static const auto code = error::channel_timeout;
 
     // v3
-    address_subscriber_->purge(code, {}, 0, {}, {});
+    subscription::list expired;
+    address_index_.purge(expired);
+    send_error(expired, code);
     ////penetration_subscriber_->purge(code, 0, {}, {});
 }
 
 // Sending.
 // ----------------------------------------------------------------------------
 
+// Sockets are not thread safe, so notifications are handed off to the worker.
 void notification_worker::send(const route& reply_to,
-    const std::string& command, uint32_t id, const data_chunk& payload)
+    const std::string& command, uint32_t id, data_chunk&& payload)
 {
-    const auto security = secure_ ? "secure" : "public";
-    const auto& endpoint = secure_ ? query_service::secure_notify :
-        query_service::public_notify;
-
-    zmq::socket notifier(authenticator_, zmq::socket::role::router);
-    auto ec = notifier.connect(endpoint);
+    // Notifications are formatted as query response messages.
+    outbox_.push(message(reply_to, command, id, std::move(payload)));
+}
 
-    if (ec == error::service_stopped)
-        return;
+// This is called only on the worker thread, which owns the socket.
+// Queued notifications are distributed to their client queues, and a client
+// disconnected by queue policy loses its subscriptions.
+size_t notification_worker::drain(socket& router)
+{
+    static const auto code = error::channel_stopped;
+    message notification(secure_);
+    subscription::list removed;
 
-    if (ec)
+    while (outbox_.pop(notification))
     {
-        LOG_WARNING(LOG_SERVER)
-            << "Failed to connect " << security << " notification worker: "
-            << ec.message();
-        return;
+        const auto reply_to = notification.route();
+
+        if (!clients_.push(std::move(notification)))
+        {
+            address_index_.unsubscribe(reply_to, removed);
+
+            LOG_WARNING(LOG_SERVER)
+                << "Disconnected lagging notification client "
+                << reply_to.display();
+        }
     }
 
-    // Notifications are formatted as query response messages.
-    message notification(reply_to, command, id, payload);
-    ec = notification.send(notifier);
+    // Termination notices are queued for the next drain.
+    send_error(removed, code);
+    return clients_.send(router, client_burst, asio::steady_clock::now());
+}
+
+// The query service returns [shard][client] for a notification that the
+// client socket rejected at high water, and the client's queue is held.
+void notification_worker::receive(socket& router)
+{
+    zmq::message packet;
+
+    if (router.receive(packet) || packet.size() != 2)
+        return;
+
+    route client;
+    client.secure = secure_;
+    client.address1 = packet.dequeue_data();
+    client.address2 = packet.dequeue_data();
+    clients_.block(client, asio::steady_clock::now() + blocked_client_delay);
+}
+
+// The time to the deadline, bounded by the maximum poller wait.
+int32_t notification_worker::wait_milliseconds(
+    const asio::time_point& deadline)
+{
+    const auto now = asio::steady_clock::now();
+
+    if (deadline <= now)
+        return 0;
+
+    const auto remaining = std::chrono::duration_cast<asio::milliseconds>(
+        deadline - now).count();
+
+    return static_cast<int32_t>(std::min<int64_t>(remaining,
+        maximum_wait_milliseconds));
+}
+
+// This is called only on the worker thread, which owns the client queues.
+void notification_worker::report()
+{
+    const auto security = secure_ ? "secure" : "public";
+    const auto outbox = outbox_.report();
 
-    if (ec && ec != error::service_stopped)
+    if (outbox.spilled > 0 || outbox.dropped > 0)
         LOG_WARNING(LOG_SERVER)
-            << "Failed to send notification to "
-            << notification.route().display() << " " << ec.message();
+            << "Full " << security << " notification queue spilled ("
+            << outbox.spilled << ") dropped (" << outbox.dropped << ")";
+
+    clients_.report([security](const route& client,
+        const route_queues::statistics& counters)
+    {
+        if (counters.dropped > 0)
+            LOG_WARNING(LOG_SERVER)
+                << "Lagging " << security << " notification client "
+                << client.display() << " queued (" << counters.queued
+                << ") peak (" << counters.peak << ") sent (" << counters.sent
+                << ") dropped (" << counters.dropped << ") disconnects ("
+                << counters.disconnects << ") blocked (" << counters.blocked
+                << ")";
+        else
+            LOG_DEBUG(LOG_SERVER)
+                << "Notification client " << client.display()
+                << " queued (" << counters.queued << ") peak ("
+                << counters.peak << ") sent (" << counters.sent << ")";
+    });
 }
 
-void notification_worker::send_address(const route& reply_to, uint32_t id,
-    uint8_t sequence, uint32_t height, const hash_digest& block_hash,
-    transaction_const_ptr tx)
+// The serialized transaction is shared by all subscribers of the relay, and
+// is copied once into each payload. The address.update2 format requires the
+// transaction within the data frame, following the header, and the protocol
+// copies each frame into its zeromq message, so it cannot be sent by reference.
+void notification_worker::send_address(subscription& subscriber,
+    uint32_t height, const hash_digest& block_hash, const data_chunk& tx)
 {
+    static constexpr size_t header_size = code_size + sizeof(uint8_t) +
+        sizeof(uint32_t) + hash_size;
+
     // [ code:4 ]
     // [ sequence:1 ]
     // [ height:4 ]
     // [ block_hash:32 ]
     // [ tx:... ]
-    const auto payload = build_chunk(
-    {
-        message::to_bytes(error::success),
-        to_array(sequence),
-        to_little_endian(height),
-        block_hash,
-        tx->to_data()
-    });
-
-    send(reply_to, address_update2, id, payload);
+    data_chunk payload(header_size + tx.size());
+    auto serial = make_unsafe_serializer(payload.begin());
+    serial.write_error_code(error::success);
+    serial.write_byte(subscriber.sequence++);
+    serial.write_4_bytes_little_endian(height);
+    serial.write_hash(block_hash);
+    serial.write_bytes(tx);
+
+    send(subscriber.reply_to, address_update2, subscriber.id,
+        std::move(payload));
 }
 
-// Handlers.
-// ----------------------------------------------------------------------------
+// Entries are full transactions or compact entries, both self-delimiting.
+void notification_worker::send_entries(subscription& subscriber,
+    uint32_t height, const hash_digest& block_hash, const entry_list& entries)
+{
+    static constexpr size_t header_size = code_size + sizeof(uint8_t) +
+        sizeof(uint8_t) + sizeof(uint32_t) + hash_size;
+
+    auto size = header_size + variable_uint_size(entries.size());
+
+    for (const auto& entry: entries)
+        size += entry->size();
 
-bool notification_worker::handle_address(const code& ec,
-    // const libbitcoin::binary& field, uint32_t height, const hash_digest& block_hash,
-    // const transaction& tx, const route& reply_to, uint32_t id,
-    // const libbitcoin::binary& prefix_filter, sequence_ptr sequence)
-    const libbitcoin::binary& field, uint32_t height, const hash_digest& block_hash,
-    transaction_const_ptr tx, const route& reply_to, uint32_t id,
-    const libbitcoin::binary& prefix_filter, sequence_ptr sequence)
+    // [ code:4 ]
+    // [ sequence:1 ]
+    // [ options:1 ]
+    // [ height:4 ]
+    // [ block_hash:32 ]
+    // [ count:varint ]
+    // [ entry:... ]...
+    data_chunk payload(size);
+    auto serial = make_unsafe_serializer(payload.begin());
+    serial.write_error_code(error::success);
+    serial.write_byte(subscriber.sequence++);
+    serial.write_byte(subscriber.options);
+    serial.write_4_bytes_little_endian(height);
+    serial.write_hash(block_hash);
+    serial.write_variable_little_endian(entries.size());
+
+    for (const auto& entry: entries)
+        serial.write_bytes(*entry);
+
+    send(subscriber.reply_to, address_update3, subscriber.id,
+        std::move(payload));
+}
+
+// The sequence is shared with updates so that clients may order rollbacks.
+void notification_worker::send_rollback(subscription& subscriber,
+    uint32_t height, const hash_digest& block_hash, const hash_list& tx_hashes)
 {
-    if (ec)
-    {
-        send(reply_to, address_update2, id, message::to_bytes(ec));
-        return false;
-    }
+    static constexpr size_t header_size = code_size + sizeof(uint8_t) +
+        sizeof(uint32_t) + hash_size;
 
-    if (prefix_filter.is_prefix_of(field))
-    {
-        send_address(reply_to, id, *sequence, height, block_hash, tx);
-        ++(*sequence);
-    }
+    // [ code:4 ]
+    // [ sequence:1 ]
+    // [ height:4 ]
+    // [ block_hash:32 ]
+    // [ count:varint ]
+    // [ tx_hash:32 ]...
+    data_chunk payload(header_size + variable_uint_size(tx_hashes.size()) +
+        tx_hashes.size() * hash_size);
+    auto serial = make_unsafe_serializer(payload.begin());
+    serial.write_error_code(error::success);
+    serial.write_byte(subscriber.sequence++);
+    serial.write_4_bytes_little_endian(height);
+    serial.write_hash(block_hash);
+    serial.write_variable_little_endian(tx_hashes.size());
+
+    for (const auto& tx_hash: tx_hashes)
+        serial.write_hash(tx_hash);
+
+    send(subscriber.reply_to, address_rollback, subscriber.id,
+        std::move(payload));
+}
 
-    return true;
+// Subscriptions with delivery options are notified with address.update3.
+const std::string& notification_worker::update_command(uint8_t options)
+{
+    return options == subscription::none ? address_update2 : address_update3;
+}
+
+// Notify each subscription of its termination (expiration or stop).
+void notification_worker::send_error(const subscription::list& subscriptions,
+    const code& ec)
+{
+    for (const auto& subscription: subscriptions)
+        send(subscription->reply_to, update_command(subscription->options),
+            subscription->id, message::to_bytes(ec));
 }
 
 // Subscribers.
@@ -279,33 +598,32 @@ bool notification_worker::handle_address(const code& ec,
 // Subscribe to address and stealth prefix notifications.
 // Each delegate must connect to the appropriate query notification endpoint.
 void notification_worker::subscribe_address(const route& reply_to, uint32_t id,
-    const libbitcoin::binary& prefix_filter, bool unsubscribe)
+    const libbitcoin::binary& prefix_filter, uint8_t options, bool unsubscribe)
 {
     static const auto error_code = error::channel_stopped;
-    const address_key key(reply_to, prefix_filter);
 
     if (unsubscribe)
     {
-        // Just as with an expiration (purge) this will cause the stored
-        // handler (notification_worker::handle_address) to be invoked but
-        // with the specified error code (error::channel_stopped) as
-        // opposed to error::channel_timeout.
-        address_subscriber_->unsubscribe(key, error_code, {}, 0, {}, {});
+        // Just as with an expiration (purge) the subscriber is notified but
+        // with the specified error code (error::channel_stopped) as opposed
+        // to error::channel_timeout.
+        const auto removed = address_index_.unsubscribe(reply_to,
+            prefix_filter);
+
+        if (removed)
+            send_error({ removed }, error_code);
+
         return;
     }
 
-    // The sequence enables the client to detect dropped messages.
-    const auto sequence = std::make_shared<uint8_t>(0);
     const auto& duration = settings_.subscription_expiration();
 
-    // This class must be kept in scope until work is terminated.
-    auto handler =
-        std::bind(&notification_worker::handle_address,
-            this, _1, _2, _3, _4, _5, reply_to, id, prefix_filter,
-                sequence);
-
-    address_subscriber_->subscribe(std::move(handler), key, duration,
-        error_code, {}, 0, {}, {});
+    // An existing subscription for the route and prefix is renewed.
+    // The subscriber is notified of rejection when stopped or at the limit.
+    if (!address_index_.subscribe(reply_to, id, prefix_filter, duration,
+        options))
+        send(reply_to, update_command(options), id,
+            message::to_bytes(error_code));
 }
 
 ////// Subscribe to transaction penetration notifications.
@@ -330,48 +648,89 @@ void notification_worker::subscribe_address(const route& reply_to, uint32_t id,
 // Notification (via blockchain).
 // ----------------------------------------------------------------------------
 
-bool notification_worker::handle_reorganization(const code& ec,
-    size_t fork_height, block_const_ptr_list_const_ptr new_blocks,
-    block_const_ptr_list_const_ptr)
+void notification_worker::notify_block(uint32_t height,
+    const hash_digest& block_hash, const transaction_fields::list& txs)
 {
-    if (stopped() || ec == error::service_stopped)
-        return false;
+    if (stopped())
+        return;
 
-    if (ec)
+    const auto matches = match_block(txs);
+
+    // Notifications are sent in block order so that sequences are monotonic.
+    // Batch subscribers receive one notification of all of their matches.
+    batch_list batches;
+    std::unordered_map<const subscription*, size_t> positions;
+
+    for (size_t index = 0; index < txs.size(); ++index)
     {
-        LOG_WARNING(LOG_SERVER)
-            << "Failure handling new block: " << ec.message();
+        const auto& tx = *txs[index];
 
-        // Don't let a failure here prevent prevent future notifications.
-        return true;
-    }
+        for (const auto& match: matches[index])
+        {
+            auto& subscriber = *match.first;
 
-    // Blockchain height is 64 bit but obelisk protocol is 32 bit.
-    auto fork_height32 = safe_unsigned<uint32_t>(fork_height);
+            if (subscriber.options == subscription::none)
+            {
+                send_address(subscriber, height, block_hash, tx.data());
+                continue;
+            }
 
-    for (const auto block: *new_blocks)
-        notify_block(safe_increment(fork_height32), block);
+            const auto entry = to_entry(subscriber, height, tx, match.second);
 
-    return true;
+            if ((subscriber.options & subscription::batch) == 0)
+            {
+                send_entries(subscriber, height, block_hash, { entry });
+                continue;
+            }
+
+            const auto it = positions.emplace(&subscriber, batches.size());
+
+            if (it.second)
+                batches.emplace_back(match.first, entry_list{});
+
+            batches[it.first->second].second.push_back(entry);
+        }
+    }
+
+    for (const auto& batch: batches)
+        send_entries(*batch.first, height, block_hash, batch.second);
 }
 
-void notification_worker::notify_block(uint32_t height,
-    block_const_ptr block)
+// Each subscriber is sent the hashes of its transactions of the block.
+// A compact subscriber will be sent the full entry of a rolled back
+// transaction, so its confirmation is abbreviated as if it was from the pool.
+void notification_worker::notify_rollback(uint32_t height,
+    const hash_digest& block_hash, const transaction_fields::list& txs)
 {
     if (stopped())
         return;
 
-    const auto block_hash = block->header().hash();
+    const auto matches = match_block(txs);
+    std::vector<std::pair<subscription::ptr, hash_list>> rollbacks;
+    std::unordered_map<const subscription*, size_t> positions;
 
-    for (const auto& tx: block->transactions())
+    for (size_t index = 0; index < txs.size(); ++index)
     {
-        // TODO: use shared pointers for block members to avoid copying.
-        auto pointer = std::make_shared<const bc::message::transaction>(tx);
+        const auto tx_hash = txs[index]->transaction().hash();
+
+        for (const auto& match: matches[index])
+        {
+            auto& subscriber = *match.first;
+
+            if ((subscriber.options & subscription::compact) != 0)
+                subscriber.remember(tx_hash);
+
+            const auto it = positions.emplace(&subscriber, rollbacks.size());
 
-        ////const auto tx_hash = tx->hash();
-        notify_transaction(height, block_hash, pointer);
-        ////notify_penetration(height, block_hash, tx_hash);
+            if (it.second)
+                rollbacks.emplace_back(match.first, hash_list{});
+
+            rollbacks[it.first->second].second.push_back(tx_hash);
+        }
     }
+
+    for (const auto& rollback: rollbacks)
+        send_rollback(*rollback.first, height, block_hash, rollback.second);
 }
 
 // Notification (via transaction inventory).
@@ -411,94 +770,143 @@ void notification_worker::notify_block(uint32_t height,
 // Notification (via mempool and blockchain).
 // ----------------------------------------------------------------------------
 
-bool notification_worker::handle_transaction_pool(const code& ec,
-    transaction_const_ptr tx)
+void notification_worker::notify_transaction(uint32_t height,
+    const hash_digest& block_hash, const transaction_fields& tx)
 {
-    if (stopped() || ec == error::service_stopped)
-        return false;
+    if (stopped())
+        return;
 
-    if (ec)
+    match_list matches;
+    match_transaction(tx, matches);
+
+    for (const auto& match: matches)
     {
-        LOG_WARNING(LOG_SERVER)
-            << "Failure handling new transaction: " << ec.message();
+        auto& subscriber = *match.first;
 
-        // Don't let a failure here prevent future notifications.
-        return true;
-    }
+        if (subscriber.options == subscription::none)
+        {
+            send_address(subscriber, height, block_hash, tx.data());
+            continue;
+        }
 
-    notify_transaction(0, null_hash, tx);
-    return true;
+        const auto entry = to_entry(subscriber, height, tx, match.second);
+
+        if ((subscriber.options & subscription::batch) == 0)
+        {
+            send_entries(subscriber, height, block_hash, { entry });
+            continue;
+        }
+
+        // Critical Section
+        ///////////////////////////////////////////////////////////////////////
+        std::lock_guard<std::mutex> lock(pool_batch_mutex_);
+        pool_batches_[match.first].push_back(entry);
+        ///////////////////////////////////////////////////////////////////////
+    }
 }
 
-// This parsing is duplicated by bc::database::data_base.
-void notification_worker::notify_transaction(uint32_t height,
-    const hash_digest& block_hash, transaction_const_ptr tx)
+// Pool matches of batch subscribers accumulate for the batch interval.
+void notification_worker::send_pool_batches()
 {
-    uint32_t prefix;
+    pool_batches batches;
 
-    // TODO: move full integer and array constructors into binary.
-    static constexpr size_t prefix_bits = sizeof(prefix) * byte_bits;
-    static constexpr size_t address_bits = short_hash_size * byte_bits;
-    const auto& outputs = tx->outputs();
+    // Critical Section
+    ///////////////////////////////////////////////////////////////////////////
+    {
+        std::lock_guard<std::mutex> lock(pool_batch_mutex_);
+        batches.swap(pool_batches_);
+    }
+    ///////////////////////////////////////////////////////////////////////////
 
-    if (stopped() || outputs.empty())
-        return;
+    for (const auto& batch: batches)
+        send_entries(*batch.first, 0, null_hash, batch.second);
+}
 
-    // see data_base::push_inputs
-    // Loop inputs and extract payment addresses.
-    for (const auto& input: tx->inputs())
-    {
-        // This is cached by database extraction (if indexed).
-        const auto address = input.address();
+// v3
+// Only subscriptions with a prefix of a field are visited.
+// Each subscriber appears once, with the positions of its matching fields.
+void notification_worker::match_transaction(const transaction_fields& tx,
+    match_list& matches) const
+{
+    const auto& fields = tx.fields();
+    subscription::list subscribers;
 
-        if (address)
-        {
-            const libbitcoin::binary field(address_bits, address.hash());
-            notify_address(field, height, block_hash, tx);
-        }
-    }
+    // Each subscriber maps to its index in matches, for constant time dedup.
+    std::unordered_map<const subscription*, size_t> indexes;
 
-    // see data_base::push_outputs
-    // Loop outputs and extract payment addresses.
-    for (const auto& output: outputs)
+    for (size_t position = 0; position < fields.size(); ++position)
     {
-        // This is cached by database extraction (if indexed).
-        const auto address = output.address();
+        subscribers.clear();
+        address_index_.match(subscribers, fields[position].value);
 
-        if (address)
+        for (const auto& subscriber: subscribers)
         {
-            const libbitcoin::binary field(address_bits, address.hash());
-            notify_address(field, height, block_hash, tx);
+            const auto index = indexes.emplace(subscriber.get(),
+                matches.size());
+
+            if (index.second)
+                matches.emplace_back(subscriber, position_list{ position });
+            else
+                matches[index.first->second].second.push_back(position);
         }
     }
+}
 
-    // see data_base::push_stealth
-    // Loop output pairs and extract stealth payments.
-    for (size_t index = 0; index < (outputs.size() - 1); ++index)
+// Matches are collected in parallel, by transaction position.
+notification_worker::block_matches notification_worker::match_block(
+    const transaction_fields::list& txs) const
+{
+    block_matches matches(txs.size());
+    const auto collect = [this, &txs, &matches](size_t first, size_t last)
     {
-        const auto& ephemeral_script = outputs[index].script();
-        const auto& payment_output = outputs[index + 1];
-
-        // Try to extract a stealth prefix from the first output.
-        // Try to extract the payment address from the second output.
-        // The address is cached by database extraction (if indexed).
-        if (payment_output.address() &&
-            to_stealth_prefix(prefix, ephemeral_script))
-        {
-            const libbitcoin::binary field(prefix_bits, to_little_endian(prefix));
-            notify_address(field, height, block_hash, tx);
-        }
-    }
+        for (auto index = first; index < last; ++index)
+            match_transaction(*txs[index], matches[index]);
+    };
+
+    parallel_for(node_.thread_pool(), txs.size(),
+        settings_.notification_parallelism, collect);
+
+    return matches;
 }
 
-// v3
-// void notification_worker::notify_address(const libbitcoin::binary& field, uint32_t height,
-//     const hash_digest& block_hash, const transaction& tx)
-void notification_worker::notify_address(const libbitcoin::binary& field, uint32_t height,
-    const hash_digest& block_hash, transaction_const_ptr tx)
+// A compact confirmation of a delivered pool transaction is its hash alone.
+notification_worker::entry_ptr notification_worker::to_entry(
+    subscription& subscriber, uint32_t height, const transaction_fields& tx,
+    const position_list& positions)
 {
-    static const auto code = error::success;
-    address_subscriber_->relay(code, field, height, block_hash, tx);
+    static constexpr size_t position_size = sizeof(uint8_t) +
+        sizeof(uint32_t) + sizeof(uint64_t);
+
+    if ((subscriber.options & subscription::compact) == 0)
+        return tx.shared_data();
+
+    const auto tx_hash = tx.transaction().hash();
+    const auto pool = (height == 0);
+
+    if (pool)
+        subscriber.remember(tx_hash);
+
+    const auto confirmation = !pool && subscriber.forget(tx_hash);
+    const auto count = confirmation ? 0 : positions.size();
+
+    // [ tx_hash:32 ]
+    // [ count:varint ]
+    // count * [ kind:1 ][ index:4 ][ value:8 ]
+    const auto entry = std::make_shared<data_chunk>(hash_size +
+        variable_uint_size(count) + count * position_size);
+    auto serial = make_unsafe_serializer(entry->begin());
+    serial.write_hash(tx_hash);
+    serial.write_variable_little_endian(count);
+
+    for (size_t index = 0; index < count; ++index)
+    {
+        const auto& field = tx.fields()[positions[index]];
+        serial.write_byte(static_cast<uint8_t>(field.kind));
+        serial.write_4_bytes_little_endian(field.index);
+        serial.write_8_bytes_little_endian(tx.value(field));
+    }
+
+    return entry;
 }
 
 ////// v3.x
@@ -508,6 +916,5 @@ void notification_worker::notify_address(const libbitcoin::binary& field, uint32
 ////    static const auto code = error::success;
 ////    penetration_subscriber_->relay(code, height, block_hash, tx_hash);
 ////}
-
 } // namespace server
 } // namespace libbitcoin
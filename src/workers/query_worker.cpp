@@ -18,8 +18,11 @@
  */
 #include <bitcoin/server/workers/query_worker.hpp>
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <string>
+#include <unordered_set>
 #include <bitcoin/protocol.hpp>
 #include <bitcoin/server/define.hpp>
 #include <bitcoin/server/interface/address.hpp>
@@ -28,6 +31,9 @@
 #include <bitcoin/server/interface/transaction_pool.hpp>
 #include <bitcoin/server/messages/message.hpp>
 #include <bitcoin/server/server_node.hpp>
+#include <bitcoin/server/services/query_service.hpp>
+#include <bitcoin/server/utility/request_coalescer.hpp>
+#include <bitcoin/server/utility/response_cache.hpp>
 
 namespace libbitcoin {
 namespace server {
@@ -35,40 +41,98 @@ namespace server {
 using namespace std::placeholders;
 using namespace bc::protocol;
 
+static const std::string fetch_block_height(
+    "blockchain.fetch_block_height");
+static const std::string fetch_transaction_index(
+    "blockchain.fetch_transaction_index");
+
+// Successful responses to these are immutable below the reorganization point.
+static const std::unordered_set<std::string> cacheable_commands
+{
+    "blockchain.fetch_block_header",
+    "blockchain.fetch_block_transaction_hashes",
+    "blockchain.fetch_transaction",
+    fetch_block_height,
+    fetch_transaction_index
+};
+
+// Identical requests in flight are answered by one execution.
+static const std::unordered_set<std::string> coalescable_commands
+{
+    "blockchain.fetch_balance",
+    "blockchain.fetch_block_header",
+    "blockchain.fetch_block_headers",
+    "blockchain.fetch_block_transaction_hashes",
+    "blockchain.fetch_history2",
+    "blockchain.fetch_history3",
+    "blockchain.fetch_history4",
+    "blockchain.fetch_spend",
+    "blockchain.fetch_stealth",
+    "blockchain.fetch_stealth2",
+    "blockchain.fetch_transaction",
+    "blockchain.fetch_unspent_outputs",
+    "transaction_pool.fetch_transaction",
+    fetch_block_height,
+    fetch_transaction_index
+};
+
 query_worker::query_worker(zmq::authenticator& authenticator,
-    server_node& node, bool secure)
+    server_node& node, bool secure, query_service::lane lane, uint16_t shard)
   : worker(node.thread_pool()),
     secure_(secure),
+    lane_(lane),
+    shard_(shard),
     verbose_(node.network_settings().verbose),
     settings_(node.server_settings()),
     node_(node),
     authenticator_(authenticator)
 {
-    // The same interface is attached to the secure and public interfaces.
+    // The same interface is attached to the secure and public interfaces,
+    // and to each lane (the service dispatches queries by command).
     attach_interface();
 }
 
 // Implement worker as a router to the query service.
 // v2 libbitcoin-client DEALER does not add delimiter frame.
 // The router drops messages for lost peers (query service) and high water.
+// Queries complete on chain threads, so many may be outstanding at once.
+// Their responses are queued and sent on this thread, which owns the socket.
+// The completion queue signals the poller, so the wait is unbounded.
 void query_worker::work()
 {
     zmq::socket router(authenticator_, zmq::socket::role::router);
 
-    // Connect socket to the service endpoint.
-    if (!started(connect(router)))
+    // Connect socket to the service endpoint and open the completion signal.
+    if (!started(connect(router) && completions_.open(authenticator_)))
         return;
 
     zmq::poller poller;
     poller.add(router);
+    poller.add(completions_.signal());
 
     while (!poller.terminated() && !stopped())
     {
-        if (poller.wait().contains(router.id()))
+        const auto ready = poller.wait();
+
+        if (ready.contains(router.id()))
             query(router);
+
+        if (ready.contains(completions_.signal().id()))
+        {
+            completions_.acknowledge();
+            drain(router);
+        }
     }
 
+    const auto counters = completions_.report();
+
+    if (counters.spilled > 0 || counters.dropped > 0)
+        LOG_WARNING(LOG_SERVER)
+            << "Full query completion queue spilled (" << counters.spilled
+            << ") dropped (" << counters.dropped << ")";
+
     // Disconnect the socket and exit this thread.
+    completions_.close();
     finished(disconnect(router));
 }
 
@@ -78,8 +142,8 @@ void query_worker::work()
 bool query_worker::connect(zmq::socket& router)
 {
     const auto security = secure_ ? "secure" : "public";
-    const auto& endpoint = secure_ ? query_service::secure_query :
-        query_service::public_query;
+    const auto endpoint = query_service::worker_endpoint(lane_, secure_,
+        shard_);
 
     const auto ec = router.connect(endpoint);
 
@@ -122,14 +186,10 @@ void query_worker::query(zmq::socket& router)
 
     // TODO: rewrite the serial blockchain interface to avoid callbacks.
     // We are using a closure vs. bind to take advantage of move arg syntax.
-    const auto sender = [&router](message&& response)
+    // The sender may be invoked on any thread, the response is sent by drain.
+    const auto sender = [this](message&& response)
     {
-        const auto ec = response.send(router);
-
-        if (ec && ec != error::service_stopped)
-            LOG_WARNING(LOG_SERVER)
-                << "Failed to send query response to "
-                << response.route().display() << " " << ec.message();
+        completions_.push(std::move(response));
     };
 
     message request(secure_);
@@ -167,12 +227,111 @@ void query_worker::query(zmq::socket& router)
             << request.route().display();
 
     // The query executor is the delegate bound by the attach method.
-    const auto& query_execute = handler->second;
+    execute(handler->second, request, sender);
+}
+
+size_t query_worker::drain(zmq::socket& router)
+{
+    size_t count = 0;
+    message response(secure_);
+
+    while (completions_.pop(response))
+    {
+        ++count;
+        const auto ec = response.send(router);
+
+        if (ec && ec != error::service_stopped)
+            LOG_WARNING(LOG_SERVER)
+                << "Failed to send query response to "
+                << response.route().display() << " " << ec.message();
+    }
+
+    return count;
+}
+
+// The height on which a response depends, if known from request or response.
+// Requests of four bytes are by height, otherwise the height is returned as
+// the first value of the result (fetch_block_height/fetch_transaction_index).
+static size_t response_height(const message& request,
+    const data_chunk& response)
+{
+    const auto& command = request.command();
+    const auto& data = request.data();
+
+    if (data.size() == sizeof(uint32_t))
+        return from_little_endian_unsafe<uint32_t>(data.begin());
+
+    if ((command == fetch_block_height || command == fetch_transaction_index)
+        && response.size() >= code_size + sizeof(uint32_t))
+        return from_little_endian_unsafe<uint32_t>(response.begin() +
+            code_size);
+
+    return response_cache::any_height;
+}
+
+static bool is_success(const data_chunk& response)
+{
+    auto deserial = make_safe_deserializer(response.begin(), response.end());
+    return !deserial.read_error_code() && deserial;
+}
+
+// Execute the request and forward result to queue.
+// Example: address.renew(node_, request, sender);
+// Example: blockchain.fetch_history2(node_, request, sender);
+void query_worker::execute(const command_handler& handler,
+    const message& request, send_handler sender)
+{
+    const auto& command = request.command();
+    auto& cache = node_.responses();
+    auto& pending = node_.pending_requests();
+    const auto cacheable = cache.enabled() &&
+        cacheable_commands.find(command) != cacheable_commands.end();
+    const auto coalescable =
+        coalescable_commands.find(command) != coalescable_commands.end();
+
+    if (!cacheable && !coalescable)
+    {
+        handler(request, sender);
+        return;
+    }
+
+    response_cache::chunk_ptr cached;
+
+    if (cacheable && cache.find(cached, command, request.data()))
+    {
+        sender(message(request, cached));
+        return;
+    }
+
+    // The epoch precedes the query so a reorganization in flight is detected,
+    // and a query following a reorganization is not coalesced with one
+    // preceding it.
+    const auto epoch = cache.epoch();
+
+    if (coalescable && pending.attach(request, sender, epoch))
+    {
+        if (verbose_)
+            LOG_DEBUG(LOG_SERVER)
+                << "Coalesced query " << command << " from "
+                << request.route().display();
+        return;
+    }
+
+    handler(request, [&cache, &pending, cacheable, coalescable, epoch,
+        request, sender](message&& response)
+    {
+        // The payload is shared (not copied) with the cache and requesters.
+        const auto data = response.share();
+
+        if (cacheable && is_success(*data))
+            cache.store(request.command(), request.data(), data,
+                response_height(request, *data), epoch);
+
+        if (coalescable)
+            pending.complete(request, epoch, data);
 
-    // Execute the request and forward result to queue.
-    // Example: address.renew(node_, request, sender);
-    // Example: blockchain.fetch_history2(node_, request, sender);
-    query_execute(request, sender);
+        sender(std::move(response));
+    });
 }
 
 // Query Interface.
@@ -206,8 +365,15 @@ void query_worker::attach(const std::string& command,
 // address.subscribe is obsoleted in v3.
 // address.subscribe2 is new in v3, also call for renew.
 // address.unsubscribe2 is new in v3 (there was never an address.unsubscribe).
+// address.subscribe3 is new in v3.x (delivery options, see address.update3).
 //-----------------------------------------------------------------------------
 // blockchain.validate is new in v3.
+// blockchain.fetch_balance is new in v3.x (computed from history).
+// blockchain.fetch_block_headers is new in v3.x (range of headers).
+// blockchain.fetch_history3 is new in v3.x (batch of addresses).
+// blockchain.fetch_history4 is new in v3.x (paged by offset).
+// blockchain.fetch_tip is new in v3.x (served from memory).
+// blockchain.fetch_unspent_outputs is new in v3.x (computed from history).
 // blockchain.broadcast is new in v3.
 // blockchain.fetch_history2 is new in v3.
 // blockchain.fetch_stealth2 is new in v3.
@@ -230,13 +396,20 @@ void query_worker::attach_interface()
     ////ATTACH(address, subscribe, node_);                      // obsoleted
     ATTACH(address, subscribe2, node_);                         // new
     ATTACH(address, unsubscribe2, node_);                       // new
+    ATTACH(address, subscribe3, node_);                         // new
 
     ////ATTACH(blockchain, fetch_history, node_);               // obsoleted
     ATTACH(blockchain, fetch_history2, node_);                  // new
+    ATTACH(blockchain, fetch_history3, node_);                  // new
+    ATTACH(blockchain, fetch_history4, node_);                  // new
+    ATTACH(blockchain, fetch_balance, node_);                   // new
+    ATTACH(blockchain, fetch_unspent_outputs, node_);           // new
     ATTACH(blockchain, fetch_block_header, node_);              // original
+    ATTACH(blockchain, fetch_block_headers, node_);             // new
     ATTACH(blockchain, fetch_block_height, node_);              // original
     ATTACH(blockchain, fetch_block_transaction_hashes, node_);  // original
     ATTACH(blockchain, fetch_last_height, node_);               // original
+    ATTACH(blockchain, fetch_tip, node_);                       // new
     ATTACH(blockchain, fetch_transaction, node_);               // original
     ATTACH(blockchain, fetch_transaction_index, node_);         // original
     ATTACH(blockchain, fetch_spend, node_);                     // original
@@ -0,0 +1,340 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <set>
+#include <boost/test/unit_test.hpp>
+#include <bitcoin/server.hpp>
+
+using namespace bc;
+using namespace bc::server;
+
+BOOST_AUTO_TEST_SUITE(address_index_tests)
+
+static const asio::duration expiration = asio::seconds(60);
+
+static route make_route(uint8_t identity)
+{
+    route reply_to;
+    reply_to.address1 = { identity };
+    return reply_to;
+}
+
+BOOST_AUTO_TEST_CASE(address_index__subscribe__limit_reached__false)
+{
+    address_index index(1, expiration);
+    BOOST_REQUIRE(index.subscribe(make_route(1), 0, binary("1"), expiration));
+    BOOST_REQUIRE(!index.subscribe(make_route(2), 0, binary("1"), expiration));
+    BOOST_REQUIRE_EQUAL(index.size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(address_index__subscribe__renewal__not_limited)
+{
+    address_index index(1, expiration);
+    BOOST_REQUIRE(index.subscribe(make_route(1), 0, binary("1"), expiration));
+    BOOST_REQUIRE(index.subscribe(make_route(1), 0, binary("1"), expiration));
+    BOOST_REQUIRE_EQUAL(index.size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(address_index__match__prefixes__only_matching)
+{
+    address_index index(0, expiration);
+    BOOST_REQUIRE(index.subscribe(make_route(1), 1, binary(""), expiration));
+    BOOST_REQUIRE(index.subscribe(make_route(2), 2, binary("1010"), expiration));
+    BOOST_REQUIRE(index.subscribe(make_route(3), 3, binary("10"), expiration));
+    BOOST_REQUIRE(index.subscribe(make_route(4), 4, binary("11"), expiration));
+    BOOST_REQUIRE(index.subscribe(make_route(5), 5, binary("1010101"), expiration));
+
+    address_index::subscription::list matches;
+    index.match(matches, binary("10100000"));
+
+    std::set<uint32_t> ids;
+    for (const auto& subscription: matches)
+        ids.insert(subscription->id);
+
+    BOOST_REQUIRE_EQUAL(matches.size(), 3u);
+    BOOST_REQUIRE(ids == std::set<uint32_t>({ 1, 2, 3 }));
+}
+
+BOOST_AUTO_TEST_CASE(address_index__unsubscribe__split_prefixes__remaining_match)
+{
+    address_index index(0, expiration);
+    BOOST_REQUIRE(index.subscribe(make_route(1), 1, binary("1010"), expiration));
+    BOOST_REQUIRE(index.subscribe(make_route(2), 2, binary("1011"), expiration));
+    BOOST_REQUIRE(index.subscribe(make_route(3), 3, binary("101"), expiration));
+
+    const auto removed = index.unsubscribe(make_route(3), binary("101"));
+    BOOST_REQUIRE(removed);
+    BOOST_REQUIRE_EQUAL(removed->id, 3u);
+    BOOST_REQUIRE(!index.unsubscribe(make_route(3), binary("101")));
+    BOOST_REQUIRE_EQUAL(index.size(), 2u);
+
+    address_index::subscription::list matches;
+    index.match(matches, binary("10110000"));
+    BOOST_REQUIRE_EQUAL(matches.size(), 1u);
+    BOOST_REQUIRE_EQUAL(matches.front()->id, 2u);
+}
+
+BOOST_AUTO_TEST_CASE(address_index__unsubscribe__route__all_of_route_removed)
+{
+    address_index index(0, expiration);
+    BOOST_REQUIRE(index.subscribe(make_route(1), 1, binary("10"), expiration));
+    BOOST_REQUIRE(index.subscribe(make_route(1), 2, binary("11"), expiration));
+    BOOST_REQUIRE(index.subscribe(make_route(2), 3, binary("1"), expiration));
+
+    address_index::subscription::list removed;
+    index.unsubscribe(make_route(1), removed);
+    BOOST_REQUIRE_EQUAL(removed.size(), 2u);
+    BOOST_REQUIRE_EQUAL(index.size(), 1u);
+
+    address_index::subscription::list matches;
+    index.match(matches, binary("11000000"));
+    BOOST_REQUIRE_EQUAL(matches.size(), 1u);
+    BOOST_REQUIRE_EQUAL(matches.front()->id, 3u);
+}
+
+BOOST_AUTO_TEST_CASE(address_index__purge__expired__removed)
+{
+    address_index index(0, expiration);
+    BOOST_REQUIRE(index.subscribe(make_route(1), 1, binary("1"), asio::seconds(0)));
+    BOOST_REQUIRE(index.subscribe(make_route(2), 2, binary("1"), expiration));
+
+    address_index::subscription::list expired;
+    index.purge(expired);
+    BOOST_REQUIRE_EQUAL(expired.size(), 1u);
+    BOOST_REQUIRE_EQUAL(expired.front()->id, 1u);
+    BOOST_REQUIRE_EQUAL(index.size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(address_index__purge__unsubscribed_and_renewed__not_expired)
+{
+    address_index index(0, expiration);
+    BOOST_REQUIRE(index.subscribe(make_route(1), 1, binary("1"), asio::seconds(0)));
+    BOOST_REQUIRE(index.subscribe(make_route(2), 2, binary("1"), asio::seconds(0)));
+    BOOST_REQUIRE(index.unsubscribe(make_route(1), binary("1")));
+    BOOST_REQUIRE(index.subscribe(make_route(2), 2, binary("1"), expiration));
+
+    address_index::subscription::list expired;
+    index.purge(expired);
+    BOOST_REQUIRE(expired.empty());
+    BOOST_REQUIRE_EQUAL(index.size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(address_index__purge__beyond_one_revolution__expired_when_due)
+{
+    // The resolution is one second, so the inner wheel spans 1024 seconds.
+    address_index index(0, asio::seconds(10));
+    const auto now = asio::steady_clock::now();
+    BOOST_REQUIRE(index.subscribe(make_route(1), 1, binary("1"), asio::seconds(5000)));
+    BOOST_REQUIRE(index.subscribe(make_route(2), 2, binary("1"), asio::seconds(1500)));
+
+    address_index::subscription::list expired;
+    index.purge(expired, now + asio::seconds(1400));
+    BOOST_REQUIRE(expired.empty());
+
+    index.purge(expired, now + asio::seconds(1502));
+    BOOST_REQUIRE_EQUAL(expired.size(), 1u);
+    BOOST_REQUIRE_EQUAL(expired.front()->id, 2u);
+
+    index.purge(expired, now + asio::seconds(4990));
+    BOOST_REQUIRE_EQUAL(expired.size(), 1u);
+
+    index.purge(expired, now + asio::seconds(5002));
+    BOOST_REQUIRE_EQUAL(expired.size(), 2u);
+    BOOST_REQUIRE_EQUAL(expired.back()->id, 1u);
+    BOOST_REQUIRE_EQUAL(index.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(address_index__purge__beyond_outer_wheel__expired_when_due)
+{
+    // The outer wheel spans 1024 revolutions of 1024 seconds.
+    address_index index(0, asio::seconds(10));
+    const auto now = asio::steady_clock::now();
+    const auto duration = asio::seconds(2000000);
+    BOOST_REQUIRE(index.subscribe(make_route(1), 1, binary("1"), duration));
+
+    address_index::subscription::list expired;
+    index.purge(expired, now + asio::seconds(1100000));
+    BOOST_REQUIRE(expired.empty());
+
+    index.purge(expired, now + duration - asio::seconds(2));
+    BOOST_REQUIRE(expired.empty());
+
+    index.purge(expired, now + duration + asio::seconds(2));
+    BOOST_REQUIRE_EQUAL(expired.size(), 1u);
+    BOOST_REQUIRE_EQUAL(index.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(address_index__purge__renewed_beyond_one_revolution__not_expired)
+{
+    address_index index(0, asio::seconds(10));
+    const auto now = asio::steady_clock::now();
+    BOOST_REQUIRE(index.subscribe(make_route(1), 1, binary("1"), asio::seconds(100)));
+    BOOST_REQUIRE(index.subscribe(make_route(1), 1, binary("1"), asio::seconds(3000)));
+
+    address_index::subscription::list expired;
+    index.purge(expired, now + asio::seconds(200));
+    BOOST_REQUIRE(expired.empty());
+
+    index.purge(expired, now + asio::seconds(2990));
+    BOOST_REQUIRE(expired.empty());
+
+    index.purge(expired, now + asio::seconds(3002));
+    BOOST_REQUIRE_EQUAL(expired.size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(address_index__resolution__short_horizon__one_second)
+{
+    address_index index(0, asio::seconds(10));
+    BOOST_REQUIRE(index.resolution() == asio::seconds(1));
+}
+
+BOOST_AUTO_TEST_CASE(address_index__from_data__to_data__round_trip)
+{
+    address_index index(0, expiration);
+    BOOST_REQUIRE(index.subscribe(make_route(1), 1, binary("1010"), expiration));
+    BOOST_REQUIRE(index.subscribe(make_route(2), 2, binary(""), expiration));
+    BOOST_REQUIRE(index.subscribe(make_route(3), 3, binary("0"), asio::seconds(0)));
+
+    data_chunk data;
+    data_sink ostream(data);
+    ostream_writer sink(ostream);
+    index.to_data(sink);
+    ostream.flush();
+
+    address_index restored(0, expiration);
+    data_source istream(data);
+    istream_reader source(istream);
+    BOOST_REQUIRE(restored.from_data(source, expiration));
+    BOOST_REQUIRE_EQUAL(restored.size(), 2u);
+
+    // Restored subscriptions are not matched until renewed.
+    address_index::subscription::list matches;
+    restored.match(matches, binary("10100000"));
+    BOOST_REQUIRE(matches.empty());
+
+    BOOST_REQUIRE(restored.subscribe(make_route(1), 1, binary("1010"), expiration));
+    BOOST_REQUIRE(restored.subscribe(make_route(2), 2, binary(""), expiration));
+    BOOST_REQUIRE_EQUAL(restored.size(), 2u);
+    restored.match(matches, binary("10100000"));
+
+    std::set<uint32_t> ids;
+    for (const auto& subscription: matches)
+        ids.insert(subscription->id);
+
+    BOOST_REQUIRE(ids == std::set<uint32_t>({ 1, 2 }));
+}
+
+BOOST_AUTO_TEST_CASE(address_index__from_data__not_renewed__expired_within_expiration)
+{
+    address_index index(0, expiration);
+    BOOST_REQUIRE(index.subscribe(make_route(1), 1, binary("1010"), expiration));
+
+    data_chunk data;
+    data_sink ostream(data);
+    ostream_writer sink(ostream);
+    index.to_data(sink);
+    ostream.flush();
+
+    address_index restored(0, expiration);
+    data_source istream(data);
+    istream_reader source(istream);
+    const auto now = asio::steady_clock::now();
+    BOOST_REQUIRE(restored.from_data(source, asio::seconds(10)));
+    BOOST_REQUIRE_EQUAL(restored.size(), 1u);
+
+    address_index::subscription::list expired;
+    restored.purge(expired, now + asio::seconds(12));
+    BOOST_REQUIRE_EQUAL(expired.size(), 1u);
+    BOOST_REQUIRE_EQUAL(restored.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(address_index__from_data__oversized_address__false)
+{
+    data_chunk data;
+    data_sink ostream(data);
+    ostream_writer sink(ostream);
+    sink.write_byte(2);
+    sink.write_8_bytes_little_endian(0);
+    sink.write_size_little_endian(1);
+    sink.write_byte(0);
+    sink.write_byte(0);
+    sink.write_size_little_endian(max_uint32);
+    ostream.flush();
+
+    address_index restored(0, expiration);
+    data_source istream(data);
+    istream_reader source(istream);
+    BOOST_REQUIRE(!restored.from_data(source, expiration));
+    BOOST_REQUIRE_EQUAL(restored.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(address_index__from_data__oversized_prefix__false)
+{
+    data_chunk data;
+    data_sink ostream(data);
+    ostream_writer sink(ostream);
+    sink.write_byte(2);
+    sink.write_8_bytes_little_endian(0);
+    sink.write_size_little_endian(1);
+    sink.write_byte(0);
+    sink.write_byte(0);
+    sink.write_size_little_endian(1);
+    sink.write_byte(1);
+    sink.write_size_little_endian(0);
+    sink.write_4_bytes_little_endian(1);
+    sink.write_size_little_endian(max_uint32);
+    ostream.flush();
+
+    address_index restored(0, expiration);
+    data_source istream(data);
+    istream_reader source(istream);
+    BOOST_REQUIRE(!restored.from_data(source, expiration));
+    BOOST_REQUIRE_EQUAL(restored.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(address_index__stop__subscribed__all_removed_and_rejected)
+{
+    address_index index(0, expiration);
+    BOOST_REQUIRE(index.subscribe(make_route(1), 1, binary("1"), expiration));
+    BOOST_REQUIRE(index.subscribe(make_route(2), 2, binary("01"), expiration));
+
+    address_index::subscription::list stopped;
+    index.stop(stopped);
+    BOOST_REQUIRE_EQUAL(stopped.size(), 2u);
+    BOOST_REQUIRE_EQUAL(index.size(), 0u);
+    BOOST_REQUIRE(!index.subscribe(make_route(3), 3, binary("1"), expiration));
+}
+
+BOOST_AUTO_TEST_CASE(address_index__subscription__forget__remembered_once__true_then_false)
+{
+    address_index index(0, expiration);
+    BOOST_REQUIRE(index.subscribe(make_route(1), 1, binary("1"), expiration,
+        address_index::subscription::compact));
+
+    address_index::subscription::list matches;
+    index.match(matches, binary("1"));
+    BOOST_REQUIRE_EQUAL(matches.size(), 1u);
+
+    auto& subscriber = *matches.front();
+    BOOST_REQUIRE(!subscriber.forget(null_hash));
+    subscriber.remember(null_hash);
+    BOOST_REQUIRE(subscriber.forget(null_hash));
+    BOOST_REQUIRE(!subscriber.forget(null_hash));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
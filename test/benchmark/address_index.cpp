@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include <bitcoin/server.hpp>
+#include "benchmark.hpp"
+
+using namespace bc;
+using namespace bc::server;
+using namespace bc::server::benchmark;
+
+// Match payment address fields against 10k, 100k and 1M subscriptions to
+// full address hashes. The index visits only the path of the field, where
+// the notifier it replaced invoked a prefix test for every subscription.
+
+static const asio::duration expiration = asio::minutes(10);
+static const size_t fields = 1000;
+
+static binary random_hash(std::mt19937& random)
+{
+    short_hash hash;
+
+    for (auto& byte: hash)
+        byte = static_cast<uint8_t>(random());
+
+    return binary(short_hash_size * byte_bits, hash);
+}
+
+static route make_route(size_t client)
+{
+    route reply_to;
+    reply_to.address1 = { 1 };
+    reply_to.address2 = to_chunk(to_little_endian(
+        static_cast<uint32_t>(client)));
+    return reply_to;
+}
+
+static void match_subscriptions(size_t subscriptions)
+{
+    std::mt19937 random(42);
+    std::vector<binary> prefixes;
+    prefixes.reserve(subscriptions);
+
+    for (size_t index = 0; index < subscriptions; ++index)
+        prefixes.push_back(random_hash(random));
+
+    // Every tenth field matches one subscription, the rest match none.
+    std::vector<binary> matched;
+    matched.reserve(fields);
+
+    for (size_t index = 0; index < fields; ++index)
+        matched.push_back(index % 10 == 0 ?
+            prefixes[random() % subscriptions] : random_hash(random));
+
+    address_index index(0, expiration);
+
+    for (size_t client = 0; client < subscriptions; ++client)
+        index.subscribe(make_route(client), 0, prefixes[client], expiration);
+
+    size_t matches = 0;
+    const auto suffix = "(" + std::to_string(subscriptions) + ")";
+
+    measure("address_index::match" + suffix, fields,
+        [&](size_t iteration)
+        {
+            address_index::subscription::list out;
+            index.match(out, matched[iteration]);
+            matches += out.size();
+        });
+
+    // The former path, a closure per subscription invoked for every field.
+    std::vector<std::function<void(const binary&)>> relay;
+    relay.reserve(subscriptions);
+
+    for (const auto& prefix: prefixes)
+        relay.push_back([&matches, prefix](const binary& field)
+        {
+            if (prefix.is_prefix_of(field))
+                ++matches;
+        });
+
+    measure("notifier relay" + suffix, fields / 10,
+        [&](size_t iteration)
+        {
+            for (const auto& handler: relay)
+                handler(matched[iteration]);
+        });
+
+    if (matches == 0)
+        std::cout << "no matches" << std::endl;
+}
+
+static const suite address_index_suite("address_index", []()
+{
+    match_subscriptions(10000);
+    match_subscriptions(100000);
+    match_subscriptions(1000000);
+});
@@ -0,0 +1,77 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBBITCOIN_SERVER_TEST_BENCHMARK_HPP
+#define LIBBITCOIN_SERVER_TEST_BENCHMARK_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace libbitcoin {
+namespace server {
+namespace benchmark {
+
+/// The number of heap allocations made by the process (see main.cpp).
+size_t allocations();
+
+/// Register a suite of measurements, run by name from the command line.
+struct suite
+{
+    suite(const std::string& name, std::function<void()> run);
+};
+
+/// Print the mean time and heap allocations per operation.
+inline void report(const std::string& name, size_t operations,
+    const std::chrono::steady_clock::duration& elapsed, size_t allocated)
+{
+    typedef std::chrono::nanoseconds nanoseconds;
+    const auto time = std::chrono::duration_cast<nanoseconds>(elapsed);
+
+    std::cout << std::left << std::setw(56) << name << std::right
+        << std::setw(14) << time.count() / operations << " ns/op"
+        << std::setw(10) << std::fixed << std::setprecision(2)
+        << static_cast<double>(allocated) / operations << " allocs/op"
+        << std::endl;
+}
+
+/// Invoke the function with each iteration index and report each iteration
+/// as an operation.
+template <typename Function>
+void measure(const std::string& name, size_t iterations, Function function)
+{
+    typedef std::chrono::steady_clock clock;
+
+    const auto allocated = allocations();
+    const auto start = clock::now();
+
+    for (size_t iteration = 0; iteration < iterations; ++iteration)
+        function(iteration);
+
+    const auto elapsed = clock::now() - start;
+    report(name, iterations, elapsed, allocations() - allocated);
+}
+
+} // namespace benchmark
+} // namespace server
+} // namespace libbitcoin
+
+#endif
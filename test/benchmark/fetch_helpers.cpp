@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <bitcoin/server.hpp>
+#include "benchmark.hpp"
+
+using namespace bc;
+using namespace bc::chain;
+using namespace bc::server;
+using namespace bc::server::benchmark;
+
+// Encoding of history and transaction responses, written in place into an
+// exact-size payload. Each response also copies the route and command of
+// the request, which are counted with the payload.
+
+static const size_t responses = 10000;
+
+static server::message make_request()
+{
+    route client;
+    client.address1 = { 1 };
+    client.address2 = { 2 };
+    return server::message(client, "blockchain.fetch_history2", 42,
+        data_chunk{});
+}
+
+static history_compact::list make_history(size_t rows)
+{
+    history_compact::list history(rows);
+
+    for (size_t row = 0; row < rows; ++row)
+    {
+        history[row].kind = point_kind::output;
+        history[row].point = output_point{ null_hash,
+            static_cast<uint32_t>(row) };
+        history[row].height = row;
+        history[row].value = row;
+    }
+
+    return history;
+}
+
+static transaction_ptr make_transaction(size_t puts)
+{
+    const input::list inputs(puts);
+    const output::list outputs(puts);
+    return std::make_shared<bc::message::transaction>(
+        transaction(1, 0, inputs, outputs));
+}
+
+static const suite fetch_helpers_suite("fetch_helpers", []()
+{
+    const auto request = make_request();
+    size_t total = 0;
+    const send_handler handler = [&total](server::message&& response)
+    {
+        total += response.data().size();
+    };
+
+    for (const size_t rows: { 1, 100, 10000 })
+    {
+        const auto history = make_history(rows);
+        const auto iterations = responses / (rows / 100 + 1);
+
+        measure("send_history_result (" + std::to_string(rows) + " rows)",
+            iterations, [&](size_t)
+            {
+                send_history_result(error::success, history, request,
+                    handler);
+            });
+    }
+
+    for (const size_t puts: { 1, 10 })
+    {
+        const auto tx = make_transaction(puts);
+
+        measure("transaction_fetched (" + std::to_string(puts) +
+            " inputs/outputs)", responses, [&](size_t)
+            {
+                transaction_fetched(error::success, tx, 0, 0, request,
+                    handler);
+            });
+    }
+
+    measure("message (code only)", responses, [&](size_t)
+    {
+        handler(server::message(request, error::not_found));
+    });
+
+    if (total == 0)
+        std::cout << "no payload" << std::endl;
+});
@@ -0,0 +1,94 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "benchmark.hpp"
+
+// Benchmarks are run by suite name, or all if none is named:
+// bitprim_server_benchmark [suite...]
+
+static std::atomic<size_t> allocated(0);
+
+// Array and nothrow forms are implemented by these in the standard library.
+void* operator new(std::size_t size)
+{
+    ++allocated;
+    const auto block = std::malloc(size == 0 ? 1 : size);
+
+    if (block == nullptr)
+        throw std::bad_alloc();
+
+    return block;
+}
+
+void operator delete(void* block) noexcept
+{
+    std::free(block);
+}
+
+namespace libbitcoin {
+namespace server {
+namespace benchmark {
+
+typedef std::pair<std::string, std::function<void()>> registration;
+
+static std::vector<registration>& suites()
+{
+    static std::vector<registration> instance;
+    return instance;
+}
+
+size_t allocations()
+{
+    return allocated.load();
+}
+
+suite::suite(const std::string& name, std::function<void()> run)
+{
+    suites().emplace_back(name, run);
+}
+
+} // namespace benchmark
+} // namespace server
+} // namespace libbitcoin
+
+int main(int argc, char* argv[])
+{
+    using namespace libbitcoin::server::benchmark;
+    const std::set<std::string> names(argv + 1, argv + argc);
+
+    for (const auto& suite: suites())
+    {
+        if (!names.empty() && names.find(suite.first) == names.end())
+            continue;
+
+        std::cout << suite.first << std::endl;
+        suite.second();
+    }
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <bitcoin/server.hpp>
+#include "benchmark.hpp"
+
+using namespace bc;
+using namespace bc::server;
+using namespace bc::server::benchmark;
+
+// Heap allocations of a response to a routed request, by how its payload is
+// provided. Each iteration builds a 1 KiB payload (one allocation), so a
+// payload copy shows as a second allocation (and a memcpy).
+
+static const size_t responses = 100000;
+static const size_t payload_size = 1024;
+
+static server::message make_request()
+{
+    route client;
+    client.address1 = { 1 };
+    client.address2 = { 2 };
+    return server::message(client, "blockchain.fetch_transaction2", 42,
+        data_chunk{});
+}
+
+static const suite message_suite("message", []()
+{
+    const auto request = make_request();
+    size_t total = 0;
+
+    measure("response (copied payload)", responses, [&](size_t)
+    {
+        const data_chunk payload(payload_size, 42);
+        const server::message response(request, payload);
+        total += response.data().size();
+    });
+
+    measure("response (moved payload)", responses, [&](size_t)
+    {
+        data_chunk payload(payload_size, 42);
+        const server::message response(request, std::move(payload));
+        total += response.data().size();
+    });
+
+    // A coalesced or cached response is shared by every requester.
+    server::message shared(request, data_chunk(payload_size, 42));
+    const auto chunk = shared.share();
+
+    measure("response (shared payload)", responses, [&](size_t)
+    {
+        const server::message response(request, chunk);
+        total += response.data().size();
+    });
+
+    measure("share (moved payload)", responses, [&](size_t)
+    {
+        server::message response(request, data_chunk(payload_size, 42));
+        total += response.share()->size();
+    });
+
+    if (total == 0)
+        std::cout << "no payload" << std::endl;
+});
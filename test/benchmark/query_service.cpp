@@ -0,0 +1,171 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include <bitcoin/protocol.hpp>
+#include <bitcoin/server.hpp>
+#include "benchmark.hpp"
+
+using namespace bc;
+using namespace bc::config;
+using namespace bc::protocol;
+using namespace bc::server;
+using namespace bc::server::benchmark;
+
+// Round trips through 1 to 16 query_broker shards over inproc transport, the
+// broker loop of query_service::work, so each query is dispatched by lane and
+// each response is forwarded by respond. Each shard has one echo worker and
+// one client that keeps a window of queries outstanding. Scaling stops at the
+// number of cores, as each shard occupies three threads.
+
+static const size_t requests_per_shard = 100000;
+static const size_t window = 100;
+static const std::string command = "blockchain.fetch_last_height";
+
+static endpoint shard_endpoint(const std::string& name, size_t shard)
+{
+    return endpoint("inproc://benchmark_" + name + "_" +
+        std::to_string(shard));
+}
+
+// The service binds its sockets before the broker runs, as does work.
+static void broker(zmq::context& context, size_t shard,
+    std::atomic<size_t>& bound)
+{
+    zmq::socket router(context, zmq::socket::role::router);
+    zmq::socket query_dealer(context, zmq::socket::role::dealer);
+    zmq::socket heavy_dealer(context, zmq::socket::role::dealer);
+    zmq::socket broadcast_dealer(context, zmq::socket::role::dealer);
+    zmq::socket notify_dealer(context, zmq::socket::role::dealer);
+    router.bind(shard_endpoint("router", shard));
+    query_dealer.bind(shard_endpoint("query", shard));
+    heavy_dealer.bind(shard_endpoint("heavy", shard));
+    broadcast_dealer.bind(shard_endpoint("broadcast", shard));
+    notify_dealer.bind(shard_endpoint("notify", shard));
+    ++bound;
+
+    query_broker shard_broker(router, query_dealer, heavy_dealer,
+        broadcast_dealer, notify_dealer, true, true);
+
+    // The broker returns on context termination.
+    shard_broker.run([]()
+    {
+        return false;
+    });
+}
+
+// The worker returns the client route and query unchanged.
+static void worker(zmq::context& context, size_t shard)
+{
+    zmq::socket dealer(context, zmq::socket::role::dealer);
+    dealer.connect(shard_endpoint("query", shard));
+
+    zmq::poller poller;
+    poller.add(dealer);
+
+    while (!poller.terminated())
+    {
+        if (!poller.wait().contains(dealer.id()))
+            continue;
+
+        zmq::message packet;
+
+        if (!dealer.receive(packet))
+            dealer.send(packet);
+    }
+}
+
+// Queries are [command][id][data], as sent by a client dealer.
+static void client(zmq::context& context, size_t shard)
+{
+    zmq::socket dealer(context, zmq::socket::role::dealer);
+    dealer.connect(shard_endpoint("router", shard));
+
+    const auto send = [&dealer](uint32_t id)
+    {
+        zmq::message request;
+        request.enqueue(command);
+        request.enqueue_little_endian(id);
+        request.enqueue(data_chunk(64, 42));
+        dealer.send(request);
+    };
+
+    size_t sent = 0;
+
+    for (; sent < window; ++sent)
+        send(static_cast<uint32_t>(sent));
+
+    for (size_t received = 0; received < requests_per_shard; ++received)
+    {
+        zmq::message response;
+        dealer.receive(response);
+
+        if (sent < requests_per_shard)
+            send(static_cast<uint32_t>(sent++));
+    }
+}
+
+static void round_trips(size_t shards)
+{
+    zmq::context context;
+    std::atomic<size_t> bound(0);
+    std::vector<std::thread> services;
+
+    // Inproc endpoints must be bound before they are connected.
+    for (size_t shard = 0; shard < shards; ++shard)
+        services.emplace_back(broker, std::ref(context), shard,
+            std::ref(bound));
+
+    while (bound < shards)
+        std::this_thread::yield();
+
+    for (size_t shard = 0; shard < shards; ++shard)
+        services.emplace_back(worker, std::ref(context), shard);
+
+    const auto allocated = allocations();
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+
+    for (size_t shard = 0; shard < shards; ++shard)
+        clients.emplace_back(client, std::ref(context), shard);
+
+    for (auto& thread: clients)
+        thread.join();
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    report("round trip (" + std::to_string(shards) + " shards)",
+        shards * requests_per_shard, elapsed, allocations() - allocated);
+
+    // Termination ends the broker and worker loops, closing their sockets.
+    context.stop();
+
+    for (auto& thread: services)
+        thread.join();
+}
+
+static const suite query_service_suite("query_service", []()
+{
+    for (size_t shards = 1; shards <= 16; shards *= 2)
+        round_trips(shards);
+});
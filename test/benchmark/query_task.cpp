@@ -0,0 +1,150 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstddef>
+#include <functional>
+#include <bitcoin/server.hpp>
+#include "benchmark.hpp"
+
+#include <boost/asio/yield.hpp>
+
+using namespace bc;
+using namespace bc::server;
+using namespace bc::server::benchmark;
+using namespace std::placeholders;
+
+// Allocations of a three-step query written as a callback chain, each step
+// binding the request and handler of the query, and as a query_task. The
+// chain call completes synchronously, as most chain fetches do.
+
+static const size_t queries = 100000;
+
+typedef std::function<void(const code&, size_t)> fetch_handler;
+typedef std::function<void(const code&, size_t)> result_handler;
+
+static void fetch(size_t value, fetch_handler handler)
+{
+    handler(error::success, value);
+}
+
+static void third_fetched(const code& ec, size_t value, size_t sum,
+    const data_chunk&, result_handler handler)
+{
+    handler(ec, sum + value);
+}
+
+static void second_fetched(const code& ec, size_t value, size_t sum,
+    const data_chunk& request, result_handler handler)
+{
+    if (ec)
+    {
+        handler(ec, 0);
+        return;
+    }
+
+    fetch(3, std::bind(third_fetched, _1, _2, sum + value, request, handler));
+}
+
+static void first_fetched(const code& ec, size_t value,
+    const data_chunk& request, result_handler handler)
+{
+    if (ec)
+    {
+        handler(ec, 0);
+        return;
+    }
+
+    fetch(2, std::bind(second_fetched, _1, _2, value, request, handler));
+}
+
+static void chained_query(const data_chunk& request, result_handler handler)
+{
+    fetch(1, std::bind(first_fetched, _1, _2, request, handler));
+}
+
+class sum_task
+  : public query_task<sum_task>
+{
+public:
+    sum_task(const data_chunk& request, result_handler handler)
+      : request_(request), handler_(handler), index_(0), value_(0), sum_(0)
+    {
+    }
+
+private:
+    friend class query_task<sum_task>;
+
+    void receive(const code& ec, size_t value)
+    {
+        ec_ = ec;
+        value_ = value;
+    }
+
+    void resume()
+    {
+        reenter(this)
+        {
+            for (index_ = 1; index_ <= 3; ++index_)
+            {
+                yield fetch(index_, next());
+
+                if (ec_)
+                {
+                    handler_(ec_, 0);
+                    yield break;
+                }
+
+                sum_ += value_;
+            }
+
+            handler_(error::success, sum_);
+        }
+    }
+
+    const data_chunk request_;
+    const result_handler handler_;
+    size_t index_;
+    size_t value_;
+    size_t sum_;
+    code ec_;
+};
+
+static const suite query_task_suite("query_task", []()
+{
+    const data_chunk request(64, 42);
+    size_t total = 0;
+    const result_handler handler = [&total](const code&, size_t sum)
+    {
+        total += sum;
+    };
+
+    measure("callback chain (3 steps)", queries, [&](size_t)
+    {
+        chained_query(request, handler);
+    });
+
+    measure("query_task (3 steps)", queries, [&](size_t)
+    {
+        sum_task::start(request, handler);
+    });
+
+    if (total != 2 * 6 * queries)
+        std::cout << "bad sum" << std::endl;
+});
+
+#include <boost/asio/unyield.hpp>
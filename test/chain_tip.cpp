@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdint>
+#include <boost/test/unit_test.hpp>
+#include <bitcoin/server.hpp>
+
+using namespace bc;
+using namespace bc::chain;
+using namespace bc::server;
+
+BOOST_AUTO_TEST_SUITE(chain_tip_tests)
+
+static header make_header(uint32_t nonce)
+{
+    return header(1, null_hash, null_hash, 0, 0, nonce);
+}
+
+BOOST_AUTO_TEST_CASE(chain_tip__get__unset__null)
+{
+    const chain_tip tip;
+    BOOST_REQUIRE(!tip.get());
+}
+
+BOOST_AUTO_TEST_CASE(chain_tip__initialize__unset__sets)
+{
+    chain_tip tip;
+    const auto top = make_header(42);
+    tip.initialize(100, top);
+    const auto snapshot = tip.get();
+    BOOST_REQUIRE(snapshot);
+    BOOST_REQUIRE_EQUAL(snapshot->height, 100u);
+    BOOST_REQUIRE(snapshot->hash == top.hash());
+    BOOST_REQUIRE(snapshot->header == top);
+}
+
+BOOST_AUTO_TEST_CASE(chain_tip__initialize__set__unchanged)
+{
+    chain_tip tip;
+    tip.set(101, make_header(1));
+
+    // A startup (or deferred) read does not replace a reorganization.
+    tip.initialize(100, make_header(2));
+    BOOST_REQUIRE_EQUAL(tip.get()->height, 101u);
+    BOOST_REQUIRE(tip.get()->hash == make_header(1).hash());
+}
+
+BOOST_AUTO_TEST_CASE(chain_tip__set__held_snapshot__unchanged)
+{
+    chain_tip tip;
+    tip.initialize(100, make_header(1));
+    const auto held = tip.get();
+    tip.set(101, make_header(2));
+    BOOST_REQUIRE_EQUAL(held->height, 100u);
+    BOOST_REQUIRE_EQUAL(tip.get()->height, 101u);
+    BOOST_REQUIRE(tip.get()->hash == make_header(2).hash());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
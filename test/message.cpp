@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <utility>
+#include <boost/test/unit_test.hpp>
+#include <bitcoin/server.hpp>
+
+using namespace bc;
+using namespace bc::server;
+
+BOOST_AUTO_TEST_SUITE(message_tests)
+
+// A payload is not copied if its buffer is retained.
+
+BOOST_AUTO_TEST_CASE(message__construct__moved_data__retains_buffer)
+{
+    const server::message request(false);
+    data_chunk payload(1000, 42);
+    const auto buffer = payload.data();
+    const server::message response(request, std::move(payload));
+    BOOST_REQUIRE_EQUAL(response.data().size(), 1000u);
+    BOOST_REQUIRE(response.data().data() == buffer);
+}
+
+BOOST_AUTO_TEST_CASE(message__share__moved_data__retains_buffer)
+{
+    const server::message request(false);
+    data_chunk payload(1000, 42);
+    const auto buffer = payload.data();
+    server::message response(request, std::move(payload));
+    const auto shared = response.share();
+    BOOST_REQUIRE(shared->data() == buffer);
+    BOOST_REQUIRE(response.data().data() == buffer);
+    BOOST_REQUIRE(response.share() == shared);
+}
+
+BOOST_AUTO_TEST_CASE(message__construct__shared_data__shares_buffer)
+{
+    const server::message request(false);
+    const auto shared = std::make_shared<const data_chunk>(1000, 42);
+    const server::message first(request, shared);
+    const server::message second(first);
+    BOOST_REQUIRE(first.data().data() == shared->data());
+    BOOST_REQUIRE(second.data().data() == shared->data());
+}
+
+BOOST_AUTO_TEST_CASE(message__construct__copied_data__copies_buffer)
+{
+    const server::message request(false);
+    const data_chunk payload(1000, 42);
+    const server::message response(request, payload);
+    BOOST_REQUIRE(response.data() == payload);
+    BOOST_REQUIRE(response.data().data() != payload.data());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
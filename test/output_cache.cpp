@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <boost/test/unit_test.hpp>
+#include <bitcoin/server.hpp>
+
+using namespace bc;
+using namespace bc::chain;
+using namespace bc::server;
+
+BOOST_AUTO_TEST_SUITE(output_cache_tests)
+
+static const short_hash address1{ { 1 } };
+static const short_hash address2{ { 2 } };
+
+static history_compact make_output(uint8_t tx, size_t height, uint64_t value)
+{
+    history_compact row;
+    row.kind = point_kind::output;
+    row.point = output_point{ hash_digest{ { tx } }, 0 };
+    row.height = height;
+    row.value = value;
+    return row;
+}
+
+static history_compact make_spend(const history_compact& output,
+    size_t height)
+{
+    history_compact row;
+    row.kind = point_kind::spend;
+    row.point = input_point{ hash_digest{ { 0xff } }, 0 };
+    row.height = height;
+    row.previous_checksum = output.point.checksum();
+    return row;
+}
+
+static output_cache::list_ptr make_outputs()
+{
+    return output_cache::to_outputs({ make_output(1, 10, 100) });
+}
+
+// A block with one transaction that pays the address.
+static block make_block(const short_hash& address_hash)
+{
+    const output payment(1,
+        script(script::to_pay_key_hash_pattern(address_hash)));
+    return block(header{}, { transaction(1, 0, {}, { payment }) });
+}
+
+BOOST_AUTO_TEST_CASE(output_cache__to_outputs__spent__lowest_spend_height)
+{
+    const auto paid = make_output(1, 10, 100);
+    const auto unspent = make_output(2, 11, 50);
+    const auto outputs = output_cache::to_outputs(
+    {
+        make_spend(paid, 14), paid, unspent, make_spend(paid, 12)
+    });
+
+    BOOST_REQUIRE_EQUAL(outputs->size(), 2u);
+    BOOST_REQUIRE((*outputs)[0].spent);
+    BOOST_REQUIRE_EQUAL((*outputs)[0].height, 10u);
+    BOOST_REQUIRE_EQUAL((*outputs)[0].spent_height, 12u);
+    BOOST_REQUIRE_EQUAL((*outputs)[0].value, 100u);
+    BOOST_REQUIRE(!(*outputs)[1].spent);
+    BOOST_REQUIRE_EQUAL((*outputs)[1].value, 50u);
+}
+
+BOOST_AUTO_TEST_CASE(output_cache__find__stored__shares_outputs)
+{
+    output_cache cache;
+    const auto outputs = make_outputs();
+    cache.store(address1, outputs, cache.epoch());
+    BOOST_REQUIRE(cache.find(address1) == outputs);
+    BOOST_REQUIRE(!cache.find(address2));
+}
+
+BOOST_AUTO_TEST_CASE(output_cache__store__existing__not_replaced)
+{
+    output_cache cache;
+    const auto outputs = make_outputs();
+    cache.store(address1, outputs, cache.epoch());
+    cache.store(address1, make_outputs(), cache.epoch());
+    BOOST_REQUIRE(cache.find(address1) == outputs);
+}
+
+BOOST_AUTO_TEST_CASE(output_cache__invalidate__paid_address__discards_only_it)
+{
+    output_cache cache;
+    cache.store(address1, make_outputs(), cache.epoch());
+    cache.store(address2, make_outputs(), cache.epoch());
+    cache.invalidate(make_block(address1));
+    BOOST_REQUIRE(!cache.find(address1));
+    BOOST_REQUIRE(cache.find(address2));
+}
+
+BOOST_AUTO_TEST_CASE(output_cache__store__epoch_invalidated__not_stored)
+{
+    output_cache cache;
+
+    // The epoch is captured before the history read, which races a block.
+    const auto epoch = cache.epoch();
+    cache.invalidate(make_block(address2));
+    cache.store(address1, make_outputs(), epoch);
+    BOOST_REQUIRE(!cache.find(address1));
+
+    cache.store(address1, make_outputs(), cache.epoch());
+    BOOST_REQUIRE(cache.find(address1));
+}
+
+BOOST_AUTO_TEST_CASE(output_cache__store__epoch_cleared__not_stored)
+{
+    output_cache cache;
+    const auto epoch = cache.epoch();
+    cache.store(address2, make_outputs(), epoch);
+    cache.clear();
+    cache.store(address1, make_outputs(), epoch);
+    BOOST_REQUIRE(!cache.find(address1));
+    BOOST_REQUIRE(!cache.find(address2));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
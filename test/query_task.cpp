@@ -0,0 +1,148 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <functional>
+#include <future>
+#include <thread>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <bitcoin/server.hpp>
+
+#include <boost/asio/yield.hpp>
+
+using namespace bc;
+using namespace bc::server;
+
+BOOST_AUTO_TEST_SUITE(query_task_tests)
+
+typedef std::function<void(const code&, size_t)> fetch_handler;
+typedef std::function<void(fetch_handler)> fetcher;
+
+// Fetch each of three values and report their sum (or the first error).
+class sum_task
+  : public query_task<sum_task>
+{
+public:
+    sum_task(fetcher fetch, std::function<void(const code&, size_t)> handler)
+      : fetch_(fetch), handler_(handler), index_(0), value_(0), sum_(0)
+    {
+    }
+
+private:
+    friend class query_task<sum_task>;
+
+    void receive(const code& ec, size_t value)
+    {
+        ec_ = ec;
+        value_ = value;
+    }
+
+    void resume()
+    {
+        reenter(this)
+        {
+            for (index_ = 0; index_ < 3; ++index_)
+            {
+                yield fetch_(next());
+
+                if (ec_)
+                {
+                    handler_(ec_, 0);
+                    yield break;
+                }
+
+                sum_ += value_;
+            }
+
+            handler_(error::success, sum_);
+        }
+    }
+
+    const fetcher fetch_;
+    const std::function<void(const code&, size_t)> handler_;
+    size_t index_;
+    size_t value_;
+    size_t sum_;
+    code ec_;
+};
+
+BOOST_AUTO_TEST_CASE(query_task__start__synchronous__completes)
+{
+    size_t calls = 0;
+    size_t result = 0;
+    const auto fetch = [&calls](fetch_handler handler)
+    {
+        handler(error::success, ++calls);
+    };
+
+    sum_task::start(fetch, [&result](const code& ec, size_t sum)
+    {
+        BOOST_REQUIRE(!ec);
+        result = sum;
+    });
+
+    BOOST_REQUIRE_EQUAL(calls, 3u);
+    BOOST_REQUIRE_EQUAL(result, 6u);
+}
+
+BOOST_AUTO_TEST_CASE(query_task__start__error__stops)
+{
+    size_t calls = 0;
+    code result;
+    const auto fetch = [&calls](fetch_handler handler)
+    {
+        ++calls;
+        handler(error::not_found, 0);
+    };
+
+    sum_task::start(fetch, [&result](const code& ec, size_t)
+    {
+        result = ec;
+    });
+
+    BOOST_REQUIRE_EQUAL(calls, 1u);
+    BOOST_REQUIRE_EQUAL(result, error::not_found);
+}
+
+BOOST_AUTO_TEST_CASE(query_task__start__asynchronous__completes)
+{
+    std::vector<std::thread> threads;
+    std::promise<size_t> promise;
+    const auto fetch = [&threads](fetch_handler handler)
+    {
+        threads.emplace_back([handler]()
+        {
+            handler(error::success, 2);
+        });
+    };
+
+    sum_task::start(fetch, [&promise](const code& ec, size_t sum)
+    {
+        BOOST_REQUIRE(!ec);
+        promise.set_value(sum);
+    });
+
+    BOOST_REQUIRE_EQUAL(promise.get_future().get(), 6u);
+
+    for (auto& thread: threads)
+        thread.join();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#include <boost/asio/unyield.hpp>
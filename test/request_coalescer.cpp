@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <bitcoin/server.hpp>
+
+using namespace bc;
+using namespace bc::server;
+
+BOOST_AUTO_TEST_SUITE(request_coalescer_tests)
+
+static const std::string command = "blockchain.fetch_transaction2";
+static const asio::duration timeout = asio::seconds(10);
+
+static server::message make_request(uint8_t client, uint32_t id,
+    const data_chunk& data)
+{
+    route client_route;
+    client_route.address1 = { 1 };
+    client_route.address2 = { client };
+    return server::message(client_route, command, id, data);
+}
+
+BOOST_AUTO_TEST_CASE(request_coalescer__attach__first__registers)
+{
+    request_coalescer coalescer(timeout);
+    const auto request = make_request(1, 42, { 1 });
+    BOOST_REQUIRE(!coalescer.attach(request, [](const server::message&) {}, 0));
+    BOOST_REQUIRE(coalescer.attach(request, [](const server::message&) {}, 0));
+}
+
+BOOST_AUTO_TEST_CASE(request_coalescer__attach__distinct_payload__registers)
+{
+    request_coalescer coalescer(timeout);
+    const auto handler = [](const server::message&) {};
+    BOOST_REQUIRE(!coalescer.attach(make_request(1, 42, { 1 }), handler, 0));
+    BOOST_REQUIRE(!coalescer.attach(make_request(1, 42, { 2 }), handler, 0));
+}
+
+BOOST_AUTO_TEST_CASE(request_coalescer__complete__attached__fans_out_by_id)
+{
+    request_coalescer coalescer(timeout);
+    std::vector<server::message> responses;
+    const auto handler = [&responses](const server::message& response)
+    {
+        responses.push_back(response);
+    };
+
+    const auto executed = make_request(1, 10, { 1 });
+    BOOST_REQUIRE(!coalescer.attach(executed, handler, 0));
+    BOOST_REQUIRE(coalescer.attach(make_request(2, 20, { 1 }), handler, 0));
+    BOOST_REQUIRE(coalescer.attach(make_request(3, 30, { 1 }), handler, 0));
+
+    // The executing request is answered by its caller, not the coalescer.
+    const auto response = std::make_shared<const data_chunk>(100, 42);
+    coalescer.complete(executed, 0, response);
+    BOOST_REQUIRE_EQUAL(responses.size(), 2u);
+
+    BOOST_REQUIRE_EQUAL(responses[0].id(), 20u);
+    BOOST_REQUIRE(responses[0].route().address2 == data_chunk{ 2 });
+    BOOST_REQUIRE(responses[0].data().data() == response->data());
+
+    BOOST_REQUIRE_EQUAL(responses[1].id(), 30u);
+    BOOST_REQUIRE(responses[1].route().address2 == data_chunk{ 3 });
+    BOOST_REQUIRE(responses[1].data().data() == response->data());
+
+    // The completed request is released, so the next is registered.
+    BOOST_REQUIRE(!coalescer.attach(executed, handler, 0));
+}
+
+BOOST_AUTO_TEST_CASE(request_coalescer__attach__distinct_epoch__registers)
+{
+    request_coalescer coalescer(timeout);
+    const auto handler = [](const server::message&) {};
+    const auto request = make_request(1, 42, { 1 });
+    BOOST_REQUIRE(!coalescer.attach(request, handler, 0));
+    BOOST_REQUIRE(!coalescer.attach(request, handler, 1));
+    BOOST_REQUIRE(coalescer.attach(request, handler, 1));
+}
+
+BOOST_AUTO_TEST_CASE(request_coalescer__attach__timed_out__registers_and_completes_attached)
+{
+    request_coalescer coalescer(timeout);
+    std::vector<server::message> responses;
+    const auto handler = [&responses](const server::message& response)
+    {
+        responses.push_back(response);
+    };
+
+    const auto now = asio::steady_clock::now();
+    const auto stalled = make_request(1, 10, { 1 });
+    BOOST_REQUIRE(!coalescer.attach(stalled, handler, 0, now));
+    BOOST_REQUIRE(coalescer.attach(make_request(2, 20, { 1 }), handler, 0,
+        now + asio::seconds(1)));
+
+    // The stalled request is not attached to once timed out.
+    const auto later = make_request(3, 30, { 1 });
+    BOOST_REQUIRE(!coalescer.attach(later, handler, 0,
+        now + asio::seconds(11)));
+
+    // The restarted request answers the requests attached to the stalled.
+    const auto response = std::make_shared<const data_chunk>(1, 42);
+    coalescer.complete(later, 0, response);
+    BOOST_REQUIRE_EQUAL(responses.size(), 1u);
+    BOOST_REQUIRE_EQUAL(responses[0].id(), 20u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
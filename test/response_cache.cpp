@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <memory>
+#include <string>
+#include <boost/test/unit_test.hpp>
+#include <bitcoin/server.hpp>
+
+using namespace bc;
+using namespace bc::server;
+
+BOOST_AUTO_TEST_SUITE(response_cache_tests)
+
+static const std::string command = "blockchain.fetch_transaction2";
+static const data_chunk request1{ 1 };
+static const data_chunk request2{ 2 };
+
+static response_cache::chunk_ptr make_response(size_t size)
+{
+    return std::make_shared<const data_chunk>(size, 42);
+}
+
+BOOST_AUTO_TEST_CASE(response_cache__find__zero_capacity__disabled)
+{
+    response_cache cache(0);
+    response_cache::chunk_ptr out;
+    cache.store(command, request1, make_response(10), 1, cache.epoch());
+    BOOST_REQUIRE(!cache.enabled());
+    BOOST_REQUIRE(!cache.find(out, command, request1));
+}
+
+BOOST_AUTO_TEST_CASE(response_cache__find__stored__shares_response)
+{
+    response_cache cache(1000000);
+    const auto response = make_response(10);
+    response_cache::chunk_ptr out;
+    cache.store(command, request1, response, 1, cache.epoch());
+    BOOST_REQUIRE(cache.find(out, command, request1));
+    BOOST_REQUIRE(out == response);
+    BOOST_REQUIRE(!cache.find(out, command, request2));
+    BOOST_REQUIRE(!cache.find(out, "blockchain.fetch_history2", request1));
+    BOOST_REQUIRE_EQUAL(cache.hits(), 1u);
+    BOOST_REQUIRE_EQUAL(cache.misses(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(response_cache__store__above_shard_capacity__not_stored)
+{
+    response_cache cache(16 * 100);
+    response_cache::chunk_ptr out;
+    cache.store(command, request1, make_response(100), 1, cache.epoch());
+    BOOST_REQUIRE(!cache.find(out, command, request1));
+}
+
+BOOST_AUTO_TEST_CASE(response_cache__store__epoch_invalidated__not_stored)
+{
+    response_cache cache(1000000);
+    response_cache::chunk_ptr out;
+
+    // The epoch is captured before the query, which races an invalidation.
+    const auto epoch = cache.epoch();
+    cache.invalidate(100);
+    cache.store(command, request1, make_response(10), 1, epoch);
+    BOOST_REQUIRE(!cache.find(out, command, request1));
+
+    cache.store(command, request1, make_response(10), 1, cache.epoch());
+    BOOST_REQUIRE(cache.find(out, command, request1));
+}
+
+BOOST_AUTO_TEST_CASE(response_cache__invalidate__fork_height__discards_above)
+{
+    response_cache cache(1000000);
+    response_cache::chunk_ptr out;
+    const data_chunk request3{ 3 };
+    cache.store(command, request1, make_response(10), 10, cache.epoch());
+    cache.store(command, request2, make_response(10), 11, cache.epoch());
+    cache.store(command, request3, make_response(10),
+        response_cache::any_height, cache.epoch());
+
+    cache.invalidate(10);
+    BOOST_REQUIRE(cache.find(out, command, request1));
+    BOOST_REQUIRE(!cache.find(out, command, request2));
+    BOOST_REQUIRE(!cache.find(out, command, request3));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,180 @@
+/**
+ * Copyright (c) 2011-2017 libbitcoin developers (see AUTHORS)
+ *
+ * This file is part of libbitcoin.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstddef>
+#include <cstdint>
+#include <boost/test/unit_test.hpp>
+#include <bitcoin/server.hpp>
+
+using namespace bc;
+using namespace bc::protocol;
+using namespace bc::server;
+
+BOOST_AUTO_TEST_SUITE(route_queues_tests)
+
+static const auto command = "address.update";
+
+static route make_route(uint8_t client)
+{
+    route client_route;
+    client_route.address1 = { 1 };
+    client_route.address2 = { client };
+    return client_route;
+}
+
+static server::message make_update(const route& client, uint32_t id)
+{
+    return server::message(client, command, id, data_chunk{ 42 });
+}
+
+// The counters of the route from a report, zeroed if not reported.
+static route_queues::statistics report(route_queues& queues,
+    const route& client)
+{
+    route_queues::statistics result{ 0, 0, 0, 0, 0, 0 };
+    queues.report([&](const route& reported,
+        const route_queues::statistics& counters)
+    {
+        if (reported == client)
+            result = counters;
+    });
+
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(route_queues__push__unbounded__queues_all)
+{
+    route_queues queues(0, queue_policy::drop_oldest);
+    const auto client = make_route(1);
+
+    for (uint32_t id = 0; id < 100; ++id)
+        BOOST_REQUIRE(queues.push(make_update(client, id)));
+
+    const auto counters = report(queues, client);
+    BOOST_REQUIRE_EQUAL(counters.queued, 100u);
+    BOOST_REQUIRE_EQUAL(counters.dropped, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(route_queues__push__full_drop_oldest__drops_one)
+{
+    route_queues queues(2, queue_policy::drop_oldest);
+    const auto client = make_route(1);
+    BOOST_REQUIRE(queues.push(make_update(client, 1)));
+    BOOST_REQUIRE(queues.push(make_update(client, 2)));
+    BOOST_REQUIRE(queues.push(make_update(client, 3)));
+
+    const auto counters = report(queues, client);
+    BOOST_REQUIRE_EQUAL(counters.queued, 2u);
+    BOOST_REQUIRE_EQUAL(counters.peak, 2u);
+    BOOST_REQUIRE_EQUAL(counters.dropped, 1u);
+    BOOST_REQUIRE_EQUAL(counters.disconnects, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(route_queues__push__full_disconnect__clears_queue)
+{
+    route_queues queues(2, queue_policy::disconnect);
+    const auto client = make_route(1);
+    BOOST_REQUIRE(queues.push(make_update(client, 1)));
+    BOOST_REQUIRE(queues.push(make_update(client, 2)));
+    BOOST_REQUIRE(!queues.push(make_update(client, 3)));
+
+    const auto counters = report(queues, client);
+    BOOST_REQUIRE_EQUAL(counters.queued, 0u);
+    BOOST_REQUIRE_EQUAL(counters.dropped, 3u);
+    BOOST_REQUIRE_EQUAL(counters.disconnects, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(route_queues__push__full_coalesce__replaces_same_id)
+{
+    route_queues queues(2, queue_policy::coalesce);
+    const auto client = make_route(1);
+    BOOST_REQUIRE(queues.push(make_update(client, 1)));
+    BOOST_REQUIRE(queues.push(make_update(client, 2)));
+    BOOST_REQUIRE(queues.push(make_update(client, 1)));
+    BOOST_REQUIRE(queues.push(make_update(client, 3)));
+
+    const auto counters = report(queues, client);
+    BOOST_REQUIRE_EQUAL(counters.queued, 2u);
+    BOOST_REQUIRE_EQUAL(counters.dropped, 2u);
+    BOOST_REQUIRE_EQUAL(counters.disconnects, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(route_queues__push__full__sheds_only_own_queue)
+{
+    route_queues queues(1, queue_policy::drop_oldest);
+    const auto lagging = make_route(1);
+    const auto other = make_route(2);
+    BOOST_REQUIRE(queues.push(make_update(other, 1)));
+    BOOST_REQUIRE(queues.push(make_update(lagging, 1)));
+    BOOST_REQUIRE(queues.push(make_update(lagging, 2)));
+
+    size_t reports = 0;
+    queues.report([&](const route& client,
+        const route_queues::statistics& counters)
+    {
+        ++reports;
+        BOOST_REQUIRE_EQUAL(counters.queued, 1u);
+        BOOST_REQUIRE_EQUAL(counters.dropped, client == lagging ? 1u : 0u);
+    });
+
+    BOOST_REQUIRE_EQUAL(reports, 2u);
+}
+
+BOOST_AUTO_TEST_CASE(route_queues__send__burst__round_robin)
+{
+    zmq::context context;
+    zmq::socket router(context, zmq::socket::role::router);
+    route_queues queues(0, queue_policy::drop_oldest);
+    const auto now = asio::steady_clock::now();
+
+    for (uint32_t id = 0; id < 3; ++id)
+    {
+        BOOST_REQUIRE(queues.push(make_update(make_route(1), id)));
+        BOOST_REQUIRE(queues.push(make_update(make_route(2), id)));
+    }
+
+    BOOST_REQUIRE_EQUAL(queues.send(router, 2, now), 4u);
+    BOOST_REQUIRE_EQUAL(queues.send(router, 2, now), 2u);
+    BOOST_REQUIRE_EQUAL(queues.send(router, 2, now), 0u);
+    BOOST_REQUIRE(queues.next() == asio::time_point::max());
+}
+
+BOOST_AUTO_TEST_CASE(route_queues__send__blocked__holds_until_resume)
+{
+    zmq::context context;
+    zmq::socket router(context, zmq::socket::role::router);
+    route_queues queues(0, queue_policy::drop_oldest);
+    const auto held = make_route(1);
+    const auto now = asio::steady_clock::now();
+    const auto resume = now + asio::seconds(1);
+    BOOST_REQUIRE(queues.push(make_update(held, 1)));
+    BOOST_REQUIRE(queues.push(make_update(make_route(2), 1)));
+
+    queues.block(held, resume);
+    BOOST_REQUIRE_EQUAL(queues.send(router, 10, now), 1u);
+    BOOST_REQUIRE(queues.next() == resume);
+    BOOST_REQUIRE_EQUAL(queues.send(router, 10, now), 0u);
+    BOOST_REQUIRE_EQUAL(queues.send(router, 10, resume), 1u);
+
+    const auto counters = report(queues, held);
+    BOOST_REQUIRE_EQUAL(counters.sent, 1u);
+    BOOST_REQUIRE_EQUAL(counters.dropped, 1u);
+    BOOST_REQUIRE_EQUAL(counters.blocked, 1u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()